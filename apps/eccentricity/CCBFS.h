@@ -88,11 +88,12 @@ void Components(graph<vertex> GA, intE* IDs) {
   intE* prevIDs = newA(intE,n);
   //initial frontier contains all unvisited vertices
   bool* frontier = newA(bool,n);
-  parallel_for(long i=0;i<n;i++)
+  parallel_for(0, n, [&] (long i) {
     if(IDs[i] == INT_E_MAX) {
       frontier[i] = 1;
       IDs[i] = prevIDs[i] = i; //label unvisited vertices with own ID
     } else frontier[i] = 0;
+  });
   
   vertexSubset Frontier(n,frontier);  
   long round = 0;
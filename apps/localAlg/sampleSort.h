@@ -67,20 +67,20 @@ void sampleSort (E* A, intT n, BinPred f) {
     //cout << "n=" << n << " num_segs=" << numSegs << endl;
 
     // generate samples with oversampling
-    parallel_for (intT j=0; j< sampleSetSize; ++j) {
+    parallel_for(0, sampleSetSize, [&] (intT j) {
       intT o = hashInt((uintT)j)%n;
       sampleSet[j] = A[o]; 
-    }
+    });
 
     // sort the samples
     quickSort(sampleSet, sampleSetSize, f);
 
     // subselect samples at even stride
     E* pivots = newA(E,numSegs-1);
-    parallel_for (intT k=0; k < numSegs-1; ++k) {
+    parallel_for(0, numSegs-1, [&] (intT k) {
       intT o = overSample*k;
       pivots[k] = sampleSet[o];
-    }
+    });
     free(sampleSet);  
     //nextTime("samples");
 
@@ -90,12 +90,12 @@ void sampleSort (E* A, intT n, BinPred f) {
     intT *offsetB = newA(intT, numR*numSegs);
 
     // sort each row and merge with samples to get counts
-    parallel_for (intT r = 0; r < numR; ++r) {
+    parallel_for(0, numR, [&] (intT r) {
       intT offset = r * rowSize;
       intT size =  (r < numR - 1) ? rowSize : n - offset;
       sampleSort(A+offset, size, f);
       mergeSeq(A + offset, pivots, segSizes + r*numSegs, size, numSegs-1, f);
-    }
+    });
     //nextTime("sort and merge");
 
     // transpose from rows to columns
@@ -103,13 +103,13 @@ void sampleSort (E* A, intT n, BinPred f) {
     transpose<intT,intT>(segSizes, offsetB).trans(numR, numSegs);
     sequence::scan(offsetB, offsetB, numR*numSegs, plus<intT>(),(intT)0);
     blockTrans<E,intT>(A, B, offsetA, offsetB, segSizes).trans(numR, numSegs);
-    {parallel_for (intT i=0; i < n; ++i) A[i] = B[i];}
+    parallel_for(0, n, [&] (intT i) { A[i] = B[i]; });
     //nextTime("transpose");
 
     free(B); free(offsetA); free(segSizes);
 
     // sort the columns
-    {parallel_for (intT i=0; i<numSegs; ++i) {
+    parallel_for(0, numSegs, [&] (intT i) {
 	intT offset = offsetB[i*numR];
 	if (i == 0) {
 	  sampleSort(A, offsetB[numR], f); // first segment
@@ -120,8 +120,7 @@ void sampleSort (E* A, intT n, BinPred f) {
 	} else { // last segment
 	  sampleSort(A+offset, n - offset, f);
 	}
-      }
-    }
+      });
     //nextTime("last sort");
     free(pivots); free(offsetB);
   }
@@ -49,7 +49,7 @@ class sparseAdditiveSet {
 
   // needs to be in separate routine due to Cilk bugs
   static void clearA(kvPair* A, long n, kvPair v) {
-    parallel_for (long i=0; i < n; i++) A[i] = v;
+    parallel_for(0, n, [&] (long i) { A[i] = v; });
   }
 
   struct notEmptyF { 
@@ -112,22 +112,25 @@ class sparseAdditiveSet {
 
   template <class F>
   void map(F f){ 
-    parallel_for(long i=0;i<m;i++)
+    parallel_for(0, m, [&] (long i) {
       if(TA[i].first != UINT_E_MAX) f(TA[i]);
+    });
   }
 
   template <class F>
   void mapIndex(F f){ 
-    parallel_for(long i=0;i<m;i++)
+    parallel_for(0, m, [&] (long i) {
       if(TA[i].first != UINT_E_MAX) f(TA[i],i);
+    });
   }
 
 
   // returns all the current entries compacted into a sequence
   _seq<kvPair> entries() {
     bool *FL = newA(bool,m);
-    parallel_for (long i=0; i < m; i++) 
+    parallel_for(0, m, [&] (long i) {
       FL[i] = (TA[i].first != UINT_E_MAX);
+    });
     _seq<kvPair> R = pack((kvPair*)NULL, FL, (uintT) 0, m, sequence::getA<kvPair,uintE>(TA));
     //sequence::pack(TA,(entry*)NULL,FL,m);
     free(FL);
@@ -138,8 +141,9 @@ class sparseAdditiveSet {
   template <class F>
   _seq<kvPair> entries(F f) {
     bool *FL = newA(bool,m);
-    parallel_for (long i=0; i < m; i++) 
+    parallel_for(0, m, [&] (long i) {
       FL[i] = (TA[i].first != UINT_E_MAX && f(TA[i]));
+    });
     _seq<kvPair> R = pack((kvPair*)NULL, FL, (uintT) 0, m, sequence::getA<kvPair,uintE>(TA));
     //sequence::pack(TA,(entry*)NULL,FL,m);
     free(FL);
@@ -152,9 +156,9 @@ class sparseAdditiveSet {
   }
 
   void copy(sparseAdditiveSet<E> &A) {
-    parallel_for(long i=0;i<A.m;i++) {
+    parallel_for(0, A.m, [&] (long i) {
       if(A.TA[i].first != UINT_E_MAX) insert(A.TA[i]);
-    }
+    });
   }
 
   // prints the current entries along with the index they are stored at
@@ -137,19 +137,19 @@ template <class vertex, class fType>
   //compute offsets into edge array
   uintT* Degrees = newA(uintT,numNonzeros+1);
   Degrees[numNonzeros]=0;
-  {parallel_for(long i=0;i<numNonzeros;i++) {
+  parallel_for(0, numNonzeros, [&] (long i) {
       uintT v = p[i].first;
       Degrees[i] = GA.V[v].getOutDegree()*2;
       ranks.insert(make_pair(v,i));
-    }}
+    });
   long totalDegree = sequence::plusScan(Degrees,Degrees,numNonzeros+1);
   //create (1,-1) if entry goes to higher ranked neighbor, else (0,0)
   pairIntT* edges = newA(pairIntT,totalDegree);
-  {parallel_for(intT i=0;i<numNonzeros;i++){
+  parallel_for(0, numNonzeros, [&] (intT i) {
     long o = Degrees[i];
     uintE v = p[i].first;
     if(GA.V[v].getOutDegree() > 1000) {
-      parallel_for(long j=0;j<GA.V[v].getOutDegree();j++){
+      parallel_for(0, GA.V[v].getOutDegree(), [&] (long j) {
 	long jj = j*2;
 	uintE ngh = GA.V[v].getOutNeighbor(j);
 	uintE rankNgh = ranks.find(ngh).second;
@@ -162,7 +162,7 @@ template <class vertex, class fType>
 	}
 	edges[o+jj].second = i;
 	edges[o+jj+1].second = rankNgh;
-      }
+      });
     } else {
       for(long j=0;j<GA.V[v].getOutDegree();j++){
 	long jj = j*2;
@@ -178,12 +178,12 @@ template <class vertex, class fType>
 	edges[o+jj].second = i;
 	edges[o+jj+1].second = rankNgh;
       }
-    }}}
+    }});
   //store edges by incident vertex id
   intSort::iSort(edges,totalDegree,numNonzeros+1,extractSecond());
   sequence::scanI(edges,edges,totalDegree,addFirst(),make_pair((intT)0,(intT)-1));
   diPair* cuts = newA(diPair,numNonzeros);
-  {parallel_for(long i=0;i<totalDegree-1;i++) {
+  parallel_for(0, totalDegree-1, [&] (long i) {
       if(edges[i].second != edges[i+1].second) {
 	//cut point
 	cuts[edges[i].second] = make_pair(edges[i].first,edges[i].second);
@@ -192,8 +192,7 @@ template <class vertex, class fType>
 	if(denom == 0) cuts[edges[i].second].first = 1;
 	else cuts[edges[i].second].first /= denom;
       }
-    }
-  }
+    });
   if(edges[totalDegree-1].second != numNonzeros) { //last edge is still in p
 	long denom = min(totalDegree/2,(intT)GA.m-totalDegree/2);
 	if(denom == 0) cuts[edges[totalDegree-1].second] = 
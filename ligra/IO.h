@@ -29,6 +29,7 @@
 #include "blockRadixSort.h"
 #include "utils.h"
 #include "graph.h"
+#include "numaPlacement.h"
 #include "trace.hpp"
 using namespace std;
 
@@ -94,13 +95,14 @@ _seq<char> readStringFromFile(char *fileName) {
 
 // parallel code for converting a string to words
 words stringToWords(char *Str, long n) {
-  {parallel_for (long i=0; i < n; i++) 
-      if (isSpace(Str[i])) Str[i] = 0; }
+  parallel_for(0, n, [&] (long i) {
+      if (isSpace(Str[i])) Str[i] = 0;
+  });
 
   // mark start of words
   bool *FL = newA(bool,n);
   FL[0] = Str[0];
-  {parallel_for (long i=1; i < n; i++) FL[i] = Str[i] && !Str[i-1];}
+  parallel_for(1, n, [&] (long i) { FL[i] = Str[i] && !Str[i-1]; });
     
   // offset for each start of word
   _seq<long> Off = sequence::packIndex<long>(FL, n);
@@ -109,7 +111,7 @@ words stringToWords(char *Str, long n) {
 
   // pointer to each start of word
   char **SA = newA(char*, m);
-  {parallel_for (long j=0; j < m; j++) SA[j] = Str+offsets[j];}
+  parallel_for(0, m, [&] (long j) { SA[j] = Str+offsets[j]; });
 
   free(offsets); free(FL);
   return words(Str,n,SA,m);
@@ -123,13 +125,11 @@ public:
   long n;
   long m;
   void* allocatedInplace, * inEdges;
-  uintE* flags;
 
   Uncompressed_Mem(vertex* VV, long nn, long mm, void* ai, void* _inEdges = NULL) 
-  : V(VV), n(nn), m(mm), allocatedInplace(ai), inEdges(_inEdges),  flags(NULL) {}
+  : V(VV), n(nn), m(mm), allocatedInplace(ai), inEdges(_inEdges) {}
 
   void del() {
-    if (flags != NULL) free(flags);
     if (allocatedInplace == NULL) 
       for (long i=0; i < n; i++) V[i].del();
     else free(allocatedInplace);
@@ -165,15 +165,18 @@ graph<vertex> readGraphFromFile(char* fname, bool isSymmetric) {
     abort();
   }
 
-  uintT* offsets = newA(uintT,n);
+  uintT* offsets = newNumaA(uintT,n);
+  parallel_for(0, n, [&] (long i) { offsets[i] = atol(W.Strings[i + 3]); });
+  //the edges of a vertex are placed on the NUMA node of the vertex
 #ifndef WEIGHTED
-  uintE* edges = newA(uintE,m);
+  uintE* edges = (uintE*) numaAllocByOffsets(sizeof(uintE),offsets,n,m);
+  TRACE_REGION("edges", edges, m);
 #else
-  intE* edges = newA(intE,2*m);
+  intE* edges = (intE*) numaAllocByOffsets(2*sizeof(intE),offsets,n,m);
+  TRACE_REGION("edges", edges, 2*m);
 #endif
 
-  {parallel_for(long i=0; i < n; i++) offsets[i] = atol(W.Strings[i + 3]);}
-  {parallel_for(long i=0; i<m; i++) {
+  parallel_for(0, m, [&] (long i) {
 #ifndef WEIGHTED
       // TODO: figure out how to map this
       //TRACE_EDGE_WRITE(i, &edges[i]);
@@ -182,34 +185,34 @@ graph<vertex> readGraphFromFile(char* fname, bool isSymmetric) {
       edges[2*i] = atol(W.Strings[i+n+3]); 
       edges[2*i+1] = atol(W.Strings[i+n+m+3]);
 #endif
-    }}
+    });
   //W.del(); // to deal with performance bug in malloc
     
-  vertex* v = newA(vertex,n);
+  vertex* v = newNumaA(vertex,n);
+  TRACE_REGION("vertices", v, n);
 
-  {parallel_for (uintT i=0; i < n; i++) {
+  parallel_for(0, n, [&] (uintT i) {
     uintT o = offsets[i];
     uintT l = ((i == n-1) ? m : offsets[i+1])-offsets[i];
     TRACE_VERTEX_WRITE(i, &v[i]);
+    TRACE_SET_VERTEX_ID(v[i], i);
     v[i].setOutDegree(l); 
 #ifndef WEIGHTED
     v[i].setOutNeighbors(edges+o);     
 #else
     v[i].setOutNeighbors(edges+2*o);
 #endif
-    }}
+    });
 
   if(!isSymmetric) {
     uintT* tOffsets = newA(uintT,n);
-    {parallel_for(long i=0;i<n;i++) tOffsets[i] = INT_T_MAX;}
+    parallel_for(0, n, [&] (long i) { tOffsets[i] = INT_T_MAX; });
 #ifndef WEIGHTED
-    uintE* inEdges = newA(uintE,m);
     intPair* temp = newA(intPair,m);
 #else
-    intE* inEdges = newA(intE,2*m);
     intTriple* temp = newA(intTriple,m);
 #endif
-    {parallel_for(long i=0;i<n;i++){
+    parallel_for(0, n, [&] (long i) {
       uintT o = offsets[i];
       TRACE_VERTEX_READ(i, &v[i]);
       for(uintT j=0;j<v[i].getOutDegree();j++){	  
@@ -219,7 +222,7 @@ graph<vertex> readGraphFromFile(char* fname, bool isSymmetric) {
 	temp[o+j] = make_pair(v[i].getOutNeighbor(j),make_pair(i,v[i].getOutWeight(j)));
 #endif
       }
-      }}
+      });
     free(offsets);
 
 #ifndef WEIGHTED
@@ -229,31 +232,36 @@ graph<vertex> readGraphFromFile(char* fname, bool isSymmetric) {
 #endif
 
     tOffsets[temp[0].first] = 0; 
+    parallel_for(1, m, [&] (long i) {
+      if(temp[i].first != temp[i-1].first) {
+	tOffsets[temp[i].first] = i;
+      }
+      });
+ 
+    //fill in offsets of degree 0 vertices by taking closest non-zero
+    //offset to the right
+    sequence::scanIBack(tOffsets,tOffsets,n,minF<uintT>(),(uintT)m);
+
+    //placed once the in-degrees are known
 #ifndef WEIGHTED
-    inEdges[0] = temp[0].second;
+    uintE* inEdges = (uintE*) numaAllocByOffsets(sizeof(uintE),tOffsets,n,m);
+    TRACE_REGION("inEdges", inEdges, m);
 #else
-    inEdges[0] = temp[0].second.first;
-    inEdges[1] = temp[0].second.second;
+    intE* inEdges = (intE*) numaAllocByOffsets(2*sizeof(intE),tOffsets,n,m);
+    TRACE_REGION("inEdges", inEdges, 2*m);
 #endif
-    {parallel_for(long i=1;i<m;i++) {
+    parallel_for(0, m, [&] (long i) {
 #ifndef WEIGHTED
       inEdges[i] = temp[i].second;
 #else
       inEdges[2*i] = temp[i].second.first; 
       inEdges[2*i+1] = temp[i].second.second;
 #endif
-      if(temp[i].first != temp[i-1].first) {
-	tOffsets[temp[i].first] = i;
-      }
-      }}
+      });
 
     free(temp);
- 
-    //fill in offsets of degree 0 vertices by taking closest non-zero
-    //offset to the right
-    sequence::scanIBack(tOffsets,tOffsets,n,minF<uintT>(),(uintT)m);
 
-    {parallel_for(long i=0;i<n;i++){
+    parallel_for(0, n, [&] (long i) {
       uintT o = tOffsets[i];
       uintT l = ((i == n-1) ? m : tOffsets[i+1])-tOffsets[i];
       TRACE_VERTEX_WRITE(i, &v[i]);
@@ -263,7 +271,7 @@ graph<vertex> readGraphFromFile(char* fname, bool isSymmetric) {
 #else
       v[i].setInNeighbors(inEdges+2*o);
 #endif
-      }}    
+      });    
 
     free(tOffsets);
     Uncompressed_Mem<vertex>* mem = new Uncompressed_Mem<vertex>(v,n,m,edges,inEdges);
@@ -297,62 +305,67 @@ graph<vertex> readGraphFromBinary(char* iFile, bool isSymmetric) {
   in >> n;
   in.close();
 
+  ifstream in3(idxFile,ifstream::in | ios::binary); //stored as longs
+  in3.seekg(0, ios::end);
+  long size = in3.tellg();
+  in3.seekg(0);
+  if(n != size/sizeof(intT)) { cout << "File size wrong\n"; abort(); }
+
+  char* t = (char *) numaAlloc(size);
+  in3.read(t,size);
+  in3.close();
+  uintT* offsets = (uintT*) t;
+
   ifstream in2(adjFile,ifstream::in | ios::binary); //stored as uints
   in2.seekg(0, ios::end);
-  long size = in2.tellg();
+  size = in2.tellg();
   in2.seekg(0);
 #ifdef WEIGHTED
   long m = size/(2*sizeof(uint));
+  char* s = (char *) numaAlloc(size);
 #else
   long m = size/sizeof(uint);
+  //the edges of a vertex are placed on the NUMA node of the vertex
+  char* s = (char *) numaAllocByOffsets(sizeof(uintE),offsets,n,m);
 #endif
-  char* s = (char *) malloc(size);
   in2.read(s,size);
   in2.close();
   uintE* edges = (uintE*) s;
 
-  ifstream in3(idxFile,ifstream::in | ios::binary); //stored as longs
-  in3.seekg(0, ios::end);
-  size = in3.tellg();
-  in3.seekg(0);
-  if(n != size/sizeof(intT)) { cout << "File size wrong\n"; abort(); }
-
-  char* t = (char *) malloc(size);
-  in3.read(t,size);
-  in3.close();
-  uintT* offsets = (uintT*) t;
-
-  vertex* v = newA(vertex,n);
-#ifdef WEIGHTED
-  intE* edgesAndWeights = newA(intE,2*m);
-  {parallel_for(long i=0;i<m;i++) {
+  vertex* v = newNumaA(vertex,n);
+  TRACE_REGION("vertices", v, n);
+#ifndef WEIGHTED
+  TRACE_REGION("edges", edges, m);
+#else
+  intE* edgesAndWeights = (intE*) numaAllocByOffsets(2*sizeof(intE),offsets,n,m);
+  TRACE_REGION("edges", edgesAndWeights, 2*m);
+  parallel_for(0, m, [&] (long i) {
     edgesAndWeights[2*i] = edges[i];
     edgesAndWeights[2*i+1] = edges[i+m]; 
-    }}
+    });
   //free(edges);
 #endif
-  {parallel_for(long i=0;i<n;i++) {
+  parallel_for(0, n, [&] (long i) {
     uintT o = offsets[i];
     uintT l = ((i==n-1) ? m : offsets[i+1])-offsets[i];
       TRACE_VERTEX_WRITE(i, &v[i]);
+      TRACE_SET_VERTEX_ID(v[i], i);
       v[i].setOutDegree(l); 
 #ifndef WEIGHTED
       v[i].setOutNeighbors((uintE*)edges+o); 
 #else
       v[i].setOutNeighbors(edgesAndWeights+2*o);
 #endif
-    }}
+    });
   if(!isSymmetric) {
     uintT* tOffsets = newA(uintT,n);
-    {parallel_for(long i=0;i<n;i++) tOffsets[i] = INT_T_MAX;}
+    parallel_for(0, n, [&] (long i) { tOffsets[i] = INT_T_MAX; });
 #ifndef WEIGHTED
-    uintE* inEdges = newA(uintE,m);
     intPair* temp = newA(intPair,m);
 #else
-    intE* inEdges = newA(intE,2*m);
     intTriple* temp = newA(intTriple,m);
 #endif
-    {parallel_for(intT i=0;i<n;i++){
+    parallel_for(0, n, [&] (intT i) {
       uintT o = offsets[i];
       for(uintT j=0;j<v[i].getOutDegree();j++){
 #ifndef WEIGHTED
@@ -361,7 +374,7 @@ graph<vertex> readGraphFromBinary(char* iFile, bool isSymmetric) {
 	temp[o+j] = make_pair(v[i].getOutNeighbor(j),make_pair(i,v[i].getOutWeight(j)));
 #endif
       }
-      }}
+      });
     free(offsets);
 #ifndef WEIGHTED
     intSort::iSort(temp,m,n+1,getFirst<uintE>());
@@ -369,28 +382,32 @@ graph<vertex> readGraphFromBinary(char* iFile, bool isSymmetric) {
     intSort::iSort(temp,m,n+1,getFirst<intPair>());
 #endif
     tOffsets[temp[0].first] = 0; 
+    parallel_for(1, m, [&] (long i) {
+      if(temp[i].first != temp[i-1].first) {
+	tOffsets[temp[i].first] = i;
+      }
+      });
+    //fill in offsets of degree 0 vertices by taking closest non-zero
+    //offset to the right
+    sequence::scanIBack(tOffsets,tOffsets,n,minF<uintT>(),(uintT)m);
+    //placed once the in-degrees are known
 #ifndef WEIGHTED
-    inEdges[0] = temp[0].second;
+    uintE* inEdges = (uintE*) numaAllocByOffsets(sizeof(uintE),tOffsets,n,m);
+    TRACE_REGION("inEdges", inEdges, m);
 #else
-    inEdges[0] = temp[0].second.first;
-    inEdges[1] = temp[0].second.second;
+    intE* inEdges = (intE*) numaAllocByOffsets(2*sizeof(intE),tOffsets,n,m);
+    TRACE_REGION("inEdges", inEdges, 2*m);
 #endif
-    {parallel_for(long i=1;i<m;i++) {
+    parallel_for(0, m, [&] (long i) {
 #ifndef WEIGHTED
       inEdges[i] = temp[i].second;
 #else
       inEdges[2*i] = temp[i].second.first;
       inEdges[2*i+1] = temp[i].second.second;
 #endif
-      if(temp[i].first != temp[i-1].first) {
-	tOffsets[temp[i].first] = i;
-      }
-      }}
+      });
     free(temp);
-    //fill in offsets of degree 0 vertices by taking closest non-zero
-    //offset to the right
-    sequence::scanIBack(tOffsets,tOffsets,n,minF<uintT>(),(uintT)m);
-    {parallel_for(long i=0;i<n;i++){
+    parallel_for(0, n, [&] (long i) {
       uintT o = tOffsets[i];
       uintT l = ((i == n-1) ? m : tOffsets[i+1])-tOffsets[i];
       TRACE_VERTEX_WRITE(i, &v[i]);
@@ -400,7 +417,7 @@ graph<vertex> readGraphFromBinary(char* iFile, bool isSymmetric) {
 #else
       v[i].setInNeighbors((intE*)(inEdges+2*o));
 #endif
-      }}
+      });
     free(tOffsets);
 #ifndef WEIGHTED
     Uncompressed_Mem<vertex>* mem = new Uncompressed_Mem<vertex>(v,n,m,edges,inEdges);
@@ -426,6 +443,47 @@ graph<vertex> readGraph(char* iFile, bool compressed, bool symmetric, bool binar
   else return readGraphFromFile<vertex>(iFile,symmetric);
 }
 
+//Converts a graph read by readGraph to the flat CSR backend (see
+//csrVertex.h): the vertex array is replaced by offsets into the same edge
+//arrays
+inline graph<csrSymmetricVertex> toCSR(graph<symmetricVertex> G) {
+  Uncompressed_Mem<symmetricVertex>* mem = (Uncompressed_Mem<symmetricVertex>*) G.D;
+  long n = G.n, m = G.m;
+  csrEdge* edges = (csrEdge*) mem->allocatedInplace;
+  csrSymmetricVertex* V = newNumaA(csrSymmetricVertex,n+1);
+  parallel_for_static(0, n, [&] (long i) {
+      V[i].offset = (G.V[i].getOutNeighbors() - edges) / CSR_STRIDE;
+  });
+  V[n].offset = m;
+  csrSymmetricVertex::edges = edges;
+  csrSymmetricVertex::vertices = V;
+  free(G.V);
+  delete mem;
+  delete G.pool;
+  delete G.planner;
+  return graph<csrSymmetricVertex>(V,n,m,new Uncompressed_Mem<csrSymmetricVertex>(V,n,m,edges));
+}
+
+inline graph<csrAsymmetricVertex> toCSR(graph<asymmetricVertex> G) {
+  Uncompressed_Mem<asymmetricVertex>* mem = (Uncompressed_Mem<asymmetricVertex>*) G.D;
+  long n = G.n, m = G.m;
+  csrEdge* outEdges = (csrEdge*) mem->allocatedInplace, *inEdges = (csrEdge*) mem->inEdges;
+  csrAsymmetricVertex* V = newNumaA(csrAsymmetricVertex,n+1);
+  parallel_for_static(0, n, [&] (long i) {
+      V[i].outOffset = (G.V[i].getOutNeighbors() - outEdges) / CSR_STRIDE;
+      V[i].inOffset = (G.V[i].getInNeighbors() - inEdges) / CSR_STRIDE;
+    });
+  V[n].outOffset = V[n].inOffset = m;
+  csrAsymmetricVertex::outEdges = outEdges;
+  csrAsymmetricVertex::inEdges = inEdges;
+  csrAsymmetricVertex::vertices = V;
+  free(G.V);
+  delete mem;
+  delete G.pool;
+  delete G.planner;
+  return graph<csrAsymmetricVertex>(V,n,m,new Uncompressed_Mem<csrAsymmetricVertex>(V,n,m,outEdges,inEdges));
+}
+
 template <class vertex>
 struct Compressed_Mem : public Deletable {
 public:
@@ -457,7 +515,9 @@ graph<vertex> readCompressedGraph(char* fname, bool isSymmetric) {
   long size = in.tellg();
   in.seekg(0);
   cout << "size = " << size << endl;
-  char* s = (char*) malloc(size);
+  //the file is read into one array, so it is split evenly over the NUMA
+  //nodes rather than by the vertices' edges
+  char* s = (char*) numaAlloc(size);
   in.read(s,size);
   long* sizes = (long*) s;
   long n = sizes[0], m = sizes[1], totalSpace = sizes[2];
@@ -470,6 +530,7 @@ graph<vertex> readCompressedGraph(char* fname, bool isSymmetric) {
   uintE* Degrees = (uintE*) (s+skip);
   skip+= n*sizeof(intE);
   uchar* edges = (uchar*)(s+skip);
+  TRACE_REGION("edges", edges, totalSpace);
 
   uintT* inOffsets;
   uchar* inEdges;
@@ -486,6 +547,7 @@ graph<vertex> readCompressedGraph(char* fname, bool isSymmetric) {
     inDegrees = (uintE*)(s+skip);
     skip += n*sizeof(uintE);
     inEdges = (uchar*)(s + skip);
+    TRACE_REGION("inEdges", inEdges, inTotalSpace);
   } else {
     inOffsets = offsets;
     inEdges = edges;
@@ -494,23 +556,24 @@ graph<vertex> readCompressedGraph(char* fname, bool isSymmetric) {
 
   in.close();
 
-  vertex *V = newA(vertex,n);
-  parallel_for(long i=0;i<n;i++) {
+  vertex *V = newNumaA(vertex,n);
+  TRACE_REGION("vertices", V, n);
+  parallel_for(0, n, [&] (long i) {
     long o = offsets[i];
     uintT d = Degrees[i];
     TRACE_VERTEX_WRITE(i, &V[i]);
     V[i].setOutDegree(d);
     V[i].setOutNeighbors(edges+o);
-  }
+  });
 
   if(sizeof(vertex) == sizeof(compressedAsymmetricVertex)){
-    parallel_for(long i=0;i<n;i++) {
+    parallel_for(0, n, [&] (long i) {
       long o = inOffsets[i];
       uintT d = inDegrees[i];
       TRACE_VERTEX_WRITE(i, &V[i]);
       V[i].setInDegree(d);
       V[i].setInNeighbors(inEdges+o);
-    }
+    });
   }
 
   cout << "creating graph..."<<endl;
@@ -0,0 +1,90 @@
+#ifndef ACCUMULATOR_H
+#define ACCUMULATOR_H
+
+// Contention-free accumulation into a vertex array from edgeMap functors.
+// Instead of a CAS loop or writeAdd on A[d], which serializes the workers
+// on the cache lines of high-degree targets, updateAtomic calls
+// acc.accumulate(d, v). The pair is appended to the worker's buffer for
+// the bin of d, a range of consecutive vertices. A full buffer is applied
+// to A under the lock of its bin, so a lock is taken once per bufferSize
+// updates, and no two workers write the same range of A at once. There
+// are at most maxBins bins, so that the buffers of a worker stay small;
+// on large graphs a bin spans n/maxBins vertices, which need not fit in
+// cache. flush() applies what is left, in parallel over the bins.
+//
+//   struct F {
+//     accumulator<double>* acc;
+//     inline bool updateAtomic(uintE s, uintE d) { acc->accumulate(d, x[s]); return 1; }
+//     void flush() { acc->flush(); } //called by edgeMap when done
+//     ...
+//   };
+//
+// A[d] is only up to date after the flush, so an updateAtomic returning
+// whether it was the first to reach d cannot accumulate; returning true
+// and passing remDups to edgeMap gives the same output. Values are
+// combined with the monoid M (see utils.h).
+#include "parallel.h"
+#include "utils.h"
+#include "numaPlacement.h"
+
+template <class T, class M = addMonoid<T> >
+struct accumulator {
+  static const int bufferSize = 128;
+  static const int maxBins = 64;
+  struct entry { uintE d; T v; };
+  T* A;
+  int P, bins, binShift, stride; //bin of d is d >> binShift
+  entry* buffers; //buffer of worker w and bin b at (w*bins+b)*bufferSize
+  //fill and locks are page aligned, and the rows of fill are whole lines
+  int* fill; //of worker w and bin b at w*stride+b, a worker's on own lines
+  int* locks; //of bin b at 16*b, one per line
+
+  accumulator(T* _A, long n) : A(_A), P(getWorkers()) {
+    binShift = 12;
+    while ((n >> binShift) >= maxBins) binShift++;
+    bins = 1 + ((n - 1) >> binShift);
+    stride = (bins + 15) & ~15;
+    buffers = newA(entry, (long)P*bins*bufferSize);
+    fill = (int*) pageAlignedAlloc((long)P*stride*sizeof(int));
+    locks = (int*) pageAlignedAlloc(16*bins*sizeof(int));
+    parallel_for(0, (long)P*stride, [&] (long i) { fill[i] = 0; });
+    parallel_for(0, bins, [&] (long b) { locks[16*b] = 0; });
+  }
+
+  //A[d] = M::combine(A[d], v), once flushed
+  inline void accumulate(uintE d, T v) {
+    int w = getWorkerNum(), b = d >> binShift;
+    int& k = fill[w*stride + b];
+    entry* e = buffers + ((long)w*bins + b)*bufferSize;
+    e[k].d = d; e[k].v = v;
+    if (++k == bufferSize) {
+      int* l = locks + 16*b;
+      while (!CAS(l, 0, 1, ATOMIC_ACQUIRE)) while (atomicLoad(l)) ;
+      apply(e, k);
+      atomicStore(l, 0, ATOMIC_RELEASE);
+      k = 0;
+    }
+  }
+
+  inline void apply(entry* e, int k) {
+    for (int j = 0; j < k; j++) A[e[j].d] = M::combine(A[e[j].d], e[j].v);
+  }
+
+  //applies the buffered values; not concurrently with accumulate
+  void flush() {
+    bool empty = 1;
+    for (long i = 0; i < (long)P*stride && empty; i++) empty = fill[i] == 0;
+    if (empty) return;
+    parallel_for(0, bins, [&] (long b) {
+      for (int w = 0; w < P; w++) {
+	int& k = fill[w*stride + b];
+	apply(buffers + ((long)w*bins + b)*bufferSize, k);
+	k = 0;
+      }
+    }, 1);
+  }
+
+  void del() { free(buffers); free(fill); free(locks); }
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef ATOMICS_H
+#define ATOMICS_H
+
+// Atomic operations on plain arrays, built on the __atomic builtins of g++
+// and clang (which std::atomic_ref is made of), with explicit memory
+// orders.
+//
+// The updates of edgeMap functors only need to be atomic, not ordered with
+// other memory accesses: what a traversal writes is read after its
+// parallel loop has joined, and the join orders it. So the operations
+// below default to relaxed order, which on x86 drops the fences that the
+// __sync builtins imply and on other machines the barriers. Code that
+// hands data from one task to another while both run (locks, flags)
+// passes acquire or release.
+//
+// Each read-modify-write first reads the location, and skips the atomic if
+// it could not change it (test before CAS): a CAS whose expected value is
+// not there, a writeMin of a larger value, a writeOr of bits already set,
+// or a writeAdd of zero. Targets of high degree, which are updated by
+// many workers but mostly already hold the result, are then only read,
+// and their cache lines stay shared. Integers are added and ored with
+// fetch_add and fetch_or instead of a CAS loop, and lowered with fetch_min
+// where the compiler has it (clang).
+#include <string.h>
+#include <type_traits>
+
+#define ATOMIC_RELAXED __ATOMIC_RELAXED
+#define ATOMIC_ACQUIRE __ATOMIC_ACQUIRE
+#define ATOMIC_RELEASE __ATOMIC_RELEASE
+#define ATOMIC_ACQ_REL __ATOMIC_ACQ_REL
+#define ATOMIC_SEQ_CST __ATOMIC_SEQ_CST
+
+template <class ET>
+inline ET atomicLoad(ET *a, int order = ATOMIC_RELAXED) {
+  ET c;
+  __atomic_load(a, &c, order);
+  return c;
+}
+
+template <class ET>
+inline void atomicStore(ET *a, ET b, int order = ATOMIC_RELAXED) {
+  __atomic_store(a, &b, order);
+}
+
+namespace atomics {
+  //the strongest order allowed for a failed CAS of the given order
+  constexpr int failureOrder(int order) {
+    return order == ATOMIC_ACQ_REL ? ATOMIC_ACQUIRE :
+      order == ATOMIC_RELEASE ? ATOMIC_RELAXED : order;
+  }
+
+  //true iff a and b have the same bits (== differs for floats)
+  template <class ET>
+  inline bool sameBits(const ET& a, const ET& b) { return memcmp(&a, &b, sizeof(ET)) == 0; }
+
+  //one CAS attempt; on failure, expected is set to the value found
+  template <class ET>
+  inline bool tryCAS(ET *ptr, ET &expected, ET newv, int order) {
+    return __atomic_compare_exchange(ptr, &expected, &newv, false, order, failureOrder(order));
+  }
+
+  template <class ET>
+  inline ET fetchAdd(ET *a, ET b, int order, std::true_type) { //integers
+    return __atomic_fetch_add(a, b, order);
+  }
+  template <class ET>
+  inline ET fetchAdd(ET *a, ET b, int order, std::false_type) { //floating point
+    ET c = atomicLoad(a);
+    while (!tryCAS(a, c, (ET)(c + b), order)) ;
+    return c;
+  }
+
+  //lowers *a, last seen holding c, to b
+  template <class ET>
+  inline bool lower(ET *a, ET c, ET b, int order, std::false_type) {
+    while (!tryCAS(a, c, b, order))
+      if (!(b < c)) return 0;
+    return 1;
+  }
+  template <class ET>
+  inline bool lower(ET *a, ET c, ET b, int order, std::true_type) {
+#if defined(__clang__)
+#if __has_builtin(__atomic_fetch_min)
+    return b < __atomic_fetch_min(a, b, order);
+#endif
+#endif
+    return lower(a, c, b, order, std::false_type());
+  }
+}
+
+//replaces *ptr by newv if it holds oldv, comparing bits; true if it did
+template <class ET>
+inline bool CAS(ET *ptr, ET oldv, ET newv, int order = ATOMIC_RELAXED) {
+  static_assert(sizeof(ET) == 1 || sizeof(ET) == 2 || sizeof(ET) == 4 || sizeof(ET) == 8,
+		"CAS: bad length");
+  if (!atomics::sameBits(atomicLoad(ptr), oldv)) return 0;
+  return atomics::tryCAS(ptr, oldv, newv, order);
+}
+
+//adds b to *a and returns the old value
+template <class ET>
+inline ET fetchAdd(ET *a, ET b, int order = ATOMIC_RELAXED) {
+  return atomics::fetchAdd(a, b, order, typename std::is_integral<ET>::type());
+}
+
+template <class ET>
+inline void writeAdd(ET *a, ET b, int order = ATOMIC_RELAXED) {
+  if (b != 0) fetchAdd(a, b, order);
+}
+
+//lowers *a to b; true if it did
+template <class ET>
+inline bool writeMin(ET *a, ET b, int order = ATOMIC_RELAXED) {
+  ET c = atomicLoad(a);
+  if (!(b < c)) return 0;
+  return atomics::lower(a, c, b, order, typename std::is_integral<ET>::type());
+}
+
+//sets the bits of b in *a; true if some were not set before
+template <class ET>
+inline bool writeOr(ET *a, ET b, int order = ATOMIC_RELAXED) {
+  if ((atomicLoad(a) & b) == b) return 0;
+  return (__atomic_fetch_or(a, b, order) & b) != b;
+}
+
+#endif
@@ -108,11 +108,11 @@ namespace intSort {
     bint* oA = (bint*) (BK+blocks);
     bint* oB = (bint*) (BK+2*blocks);
 
-    parallel_for_1 (long i=0; i < blocks; i++) {
+    parallel_for(0, blocks, [&] (long i) {
       bint od = i*nn;
       long nni = min(max<long>(n-od,0),nn);
       radixBlock(A+od, B, Tmp+od, cnts + m*i, oB + m*i, od, nni, m, extract);
-    }
+    }, 1);
 
     transpose<bint,bint>(cnts, oA).trans(blocks, m);
 
@@ -167,7 +167,7 @@ namespace intSort {
       bint* offsets = BK[0];
       long remain = numBK - BUCKETS - 1;
       float y = remain / (float) n;
-      parallel_for (int i = 0; i < BUCKETS; i++) {
+      parallel_for(0, BUCKETS, [&] (int i) {
 	long segOffset = offsets[i];
 	long segNextOffset = (i == BUCKETS-1) ? n : offsets[i+1];
 	long segLen = segNextOffset - segOffset;
@@ -177,7 +177,7 @@ namespace intSort {
 	radixLoopTopDown(A + segOffset, B + segOffset, Tmp + segOffset, 
 			 BK + blocksOffset, blockLen, segLen,
 			 bits-MAX_RADIX, f);
-      }
+      });
     } else {
       radixLoopBottomUp(A, B, Tmp, BK, numBK, n, bits, false, f);
     }
@@ -214,8 +214,9 @@ namespace intSort {
       radixStep(A, B, Tmp, BK, numBK, n, (long) 1 << bits, true, 
 		eBits<E,F>(bits,0,f));
       if (bucketOffsets != NULL) {
-	parallel_for (long i = 0; i < m; i++) 
+	parallel_for(0, m, [&] (long i) {
 	  bucketOffsets[i] = BK[0][i];
+	});
       }
       return;
     } else if (bottomUp)
@@ -223,12 +224,12 @@ namespace intSort {
     else
       radixLoopTopDown(A, B, Tmp, BK, numBK, n, bits, f);
     if (bucketOffsets != NULL) {
-      {parallel_for (long i=0; i < m; i++) bucketOffsets[i] = n;}
-      {parallel_for (long i=0; i < n-1; i++) {
+      parallel_for(0, m, [&] (long i) { bucketOffsets[i] = n; });
+      parallel_for(0, n-1, [&] (long i) {
 	  long v = f(A[i]);
 	  long vn = f(A[i+1]);
 	  if (v != vn) bucketOffsets[vn] = i+1;
-	}}
+	});
       bucketOffsets[f(A[0])] = 0;
       sequence::scanIBack(bucketOffsets, bucketOffsets, m,
 			  minF<oint>(), (oint) n);
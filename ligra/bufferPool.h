@@ -0,0 +1,149 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+// Scratch buffers of edgeMap, kept by the graph across rounds and across
+// Compute calls instead of being malloc'd and freed by every edgeMap. A
+// buffer taken with get() is the smallest free one that is large enough;
+// if there is none the largest free buffer is replaced by a new one, whose
+// pages are touched in parallel so the page faults are taken once, by the
+// workers that will use the memory. Buffers are only released by del().
+//
+// Arrays handed out to the caller in a vertexSubset are not pooled, since
+// the application frees them.
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <stdlib.h>
+#include "parallel.h"
+#include "utils.h"
+
+struct bufferPool {
+  struct buffer {
+    char* A;
+    size_t bytes;
+    bool used;
+  };
+  std::vector<buffer> buffers;
+  std::mutex lock;
+  uintE* flags; // for remDuplicates, all UINT_E_MAX between calls
+  long flagsN;
+  // per-worker output of edgeMapSparse, one cache line each
+  struct workerBuffer {
+    uintE* A;
+    long n, size;
+    char pad[64 - sizeof(uintE*) - 2*sizeof(long)];
+  };
+  workerBuffer* workers;
+  int numWorkers;
+  size_t held, peak, inUse, peakInUse;
+  long allocs, reuses;
+
+  bufferPool() : flags(NULL), flagsN(0), workers(NULL), numWorkers(0), held(0), peak(0), inUse(0), peakInUse(0),
+                 allocs(0), reuses(0) {}
+
+  void* getBytes(size_t bytes) {
+    // round up to whole pages so buffers fit more future requests
+    bytes = (bytes + 4095) & ~(size_t)4095;
+    if (bytes == 0) bytes = 4096;
+    std::lock_guard<std::mutex> g(lock);
+    long best = -1, largest = -1;
+    for (long i = 0; i < (long)buffers.size(); i++) {
+      if (buffers[i].used) continue;
+      if (buffers[i].bytes >= bytes && (best < 0 || buffers[i].bytes < buffers[best].bytes)) best = i;
+      if (largest < 0 || buffers[i].bytes > buffers[largest].bytes) largest = i;
+    }
+    if (best < 0) {
+      if (largest >= 0) {
+        held -= buffers[largest].bytes;
+        free(buffers[largest].A);
+        buffers[largest] = buffers.back();
+        buffers.pop_back();
+      }
+      char* A = newA(char,bytes);
+      parallel_for(0, ((long)bytes + 4095)/4096, [&] (long p) { A[4096*p] = 0; });
+      buffers.push_back(buffer{A, bytes, false});
+      best = buffers.size() - 1;
+      held += bytes;
+      if (held > peak) peak = held;
+      allocs++;
+    } else reuses++;
+    buffers[best].used = true;
+    inUse += buffers[best].bytes;
+    if (inUse > peakInUse) peakInUse = inUse;
+    return buffers[best].A;
+  }
+
+  template <class E>
+  E* get(long n) { return (E*) getBytes(n * sizeof(E)); }
+
+  void put(void* A) {
+    std::lock_guard<std::mutex> g(lock);
+    for (size_t i = 0; i < buffers.size(); i++)
+      if (buffers[i].A == A) {
+        buffers[i].used = false;
+        inUse -= buffers[i].bytes;
+        return;
+      }
+    std::cout << "bufferPool: put of unknown buffer" << std::endl;
+    abort();
+  }
+
+  // n flags for remDuplicates, allocated on first use
+  uintE* dedupFlags(long n) {
+    if (flagsN < n) {
+      if (flags != NULL) free(flags);
+      flags = newA(uintE,n);
+      parallel_for(0, n, [&] (long i) { flags[i] = UINT_E_MAX; });
+      flagsN = n;
+    }
+    return flags;
+  }
+
+  // empty output buffers for all workers
+  workerBuffer* workerBuffers() {
+    if (numWorkers < getWorkers()) {
+      workers = (workerBuffer*) realloc(workers, getWorkers() * sizeof(workerBuffer));
+      for (int w = numWorkers; w < getWorkers(); w++) { workers[w].A = NULL; workers[w].size = 0; }
+      numWorkers = getWorkers();
+    }
+    for (int w = 0; w < numWorkers; w++) workers[w].n = 0;
+    return workers;
+  }
+
+  // appends A[0..n-1] to the buffer of worker w
+  void append(int w, uintE* A, long n) {
+    workerBuffer& b = workers[w];
+    if (b.n + n > b.size) {
+      b.size = std::max(std::max(2*b.size, b.n + n), 1024L);
+      b.A = (uintE*) realloc(b.A, b.size * sizeof(uintE));
+    }
+    for (long i = 0; i < n; i++) b.A[b.n + i] = A[i];
+    b.n += n;
+  }
+
+  void print() {
+    std::cout << "edgeMap buffers: " << allocs << " allocations, " << reuses << " reuses, peak "
+              << peak << " bytes held, " << peakInUse << " bytes in use";
+    if (flags != NULL) std::cout << ", " << flagsN * sizeof(uintE) << " bytes of dedup flags";
+    long workerBytes = 0;
+    for (int w = 0; w < numWorkers; w++) workerBytes += workers[w].size * sizeof(uintE);
+    if (workerBytes > 0) std::cout << ", " << workerBytes << " bytes of sparse output";
+    std::cout << std::endl;
+  }
+
+  void del() {
+    for (size_t i = 0; i < buffers.size(); i++) free(buffers[i].A);
+    buffers.clear();
+    if (flags != NULL) free(flags);
+    flags = NULL;
+    flagsN = 0;
+    for (int w = 0; w < numWorkers; w++) free(workers[w].A);
+    free(workers);
+    workers = NULL;
+    numWorkers = 0;
+    held = inUse = 0;
+  }
+};
+
+#endif
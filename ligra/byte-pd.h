@@ -30,6 +30,7 @@
 #include <cmath>
 #include "parallel.h"
 #include "utils.h"
+#include "grainProfile.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -122,8 +123,8 @@ template <class T, class F>
       startEdge = edge;
       if(!t.srcTarg(f, source,startEdge,edgeID)) return;
     }
-    //do remaining chunks in parallel
-    parallel_for(long i=1;i<numChunks;i++) {
+    //do remaining chunks, in parallel from the nested cutoff on (see grainProfile.h)
+    parallel_for_edges(degree, 1, numChunks, [&] (long i) {
       long o = i*PARALLEL_DEGREE;
       long end = min<long>(o+PARALLEL_DEGREE,degree);
       uchar* myStart = edgeStart + pOffsets[i-1];
@@ -137,7 +138,7 @@ template <class T, class F>
 	startEdge = edge;
 	if(!t.srcTarg(f, source,startEdge,edgeID)) break;
       }
-    }   
+    }, PARALLEL_DEGREE);   
   }
 }
 
@@ -163,8 +164,8 @@ template <class T, class F>
       intE weight = eatWeight(start);
       if(!t.srcTarg(f, source,startEdge,weight,edgeID)) return;
     }
-    //do remaining chunks in parallel
-    parallel_for(long i=1;i<numChunks;i++) {
+    //do remaining chunks, in parallel from the nested cutoff on (see grainProfile.h)
+    parallel_for_edges(degree, 1, numChunks, [&] (long i) {
       long o = i*PARALLEL_DEGREE;
       long end = min<long>(o+PARALLEL_DEGREE,degree);
       uchar* myStart = edgeStart + pOffsets[i-1];
@@ -179,7 +180,7 @@ template <class T, class F>
 	intE weight = eatWeight(myStart);
 	if(!t.srcTarg(f, source, edge, weight, edgeID)) break;
       }
-    }
+    }, PARALLEL_DEGREE);
   }
 }
 
@@ -288,23 +289,23 @@ uintE *parallelCompressEdges(uintE *edges, uintT *offsets, long n, long m, uintE
   uintT *degrees = newA(uintT, n+1);
   long *charsUsedArr = newA(long, n);
   long *compressionStarts = newA(long, n+1);
-  {parallel_for(long i=0; i<n; i++) { 
+  parallel_for(0, n, [&] (long i) { 
       degrees[i] = Degrees[i];
     charsUsedArr[i] = ceil((degrees[i] * 9) / 8) + 4;
-  }}
+  });
   degrees[n] = 0;
   sequence::plusScan(degrees,degrees, n+1);
   long toAlloc = sequence::plusScan(charsUsedArr,charsUsedArr,n);
   uintE* iEdges = newA(uintE,toAlloc);
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
       edgePts[i] = iEdges+charsUsedArr[i];
       long charsUsed = 
 	sequentialCompressEdgeSet((uchar *)(iEdges+charsUsedArr[i]), 
 				  0, degrees[i+1]-degrees[i],
 				  i, edges + offsets[i]);
       charsUsedArr[i] = charsUsed;
-  }}
+  });
 
   // produce the total space needed for all compressed lists in chars. 
   long totalSpace = sequence::plusScan(charsUsedArr, compressionStarts, n);
@@ -317,11 +318,11 @@ uintE *parallelCompressEdges(uintE *edges, uintT *offsets, long n, long m, uintE
   float avgBitsPerEdge = (float)totalSpace*8 / (float)m; 
   cout << "Average bits per edge: " << avgBitsPerEdge << endl;
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
       long o = compressionStarts[i];
     memcpy(finalArr + o, (uchar *)(edgePts[i]), compressionStarts[i+1]-o);
     offsets[i] = o;
-  }}
+  });
   offsets[n] = totalSpace;
   free(iEdges);
   free(edgePts);
@@ -385,21 +386,21 @@ uchar *parallelCompressWeightedEdges(intEPair *edges, uintT *offsets, long n, lo
   uintT *degrees = newA(uintT, n+1);
   long *charsUsedArr = newA(long, n);
   long *compressionStarts = newA(long, n+1);
-  {parallel_for(long i=0; i<n; i++) { 
+  parallel_for(0, n, [&] (long i) { 
     degrees[i] = Degrees[i];
     charsUsedArr[i] = 2*(ceil((degrees[i] * 9) / 8) + 4); //to change
-  }}
+  });
   degrees[n] = 0;
   sequence::plusScan(degrees,degrees, n+1);
   long toAlloc = sequence::plusScan(charsUsedArr,charsUsedArr,n);
   uintE* iEdges = newA(uintE,toAlloc);
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
     edgePts[i] = iEdges+charsUsedArr[i];
     long charsUsed = 
       sequentialCompressWeightedEdgeSet((uchar *)(iEdges+charsUsedArr[i]), 0, degrees[i+1]-degrees[i],i, edges + offsets[i]);
     charsUsedArr[i] = charsUsed;
-  }}
+  });
 
   // produce the total space needed for all compressed lists in chars. 
   long totalSpace = sequence::plusScan(charsUsedArr, compressionStarts, n);
@@ -412,11 +413,11 @@ uchar *parallelCompressWeightedEdges(intEPair *edges, uintT *offsets, long n, lo
   float avgBitsPerEdge = (float)totalSpace*8 / (float)m; 
   cout << "Average bits per edge: " << avgBitsPerEdge << endl;
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
       long o = compressionStarts[i];
     memcpy(finalArr + o, (uchar *)(edgePts[i]), compressionStarts[i+1]-o);
     offsets[i] = o;
-  }}
+  });
   offsets[n] = totalSpace;
   free(iEdges);
   free(edgePts);
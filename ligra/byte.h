@@ -242,23 +242,23 @@ uintE *parallelCompressEdges(uintE *edges, uintT *offsets, long n, long m, uintE
   uintT *degrees = newA(uintT, n+1);
   long *charsUsedArr = newA(long, n);
   long *compressionStarts = newA(long, n+1);
-  {parallel_for(long i=0; i<n; i++) { 
+  parallel_for(0, n, [&] (long i) { 
       degrees[i] = Degrees[i];
     charsUsedArr[i] = ceil((degrees[i] * 9) / 8) + 4;
-  }}
+  });
   degrees[n] = 0;
   sequence::plusScan(degrees,degrees, n+1);
   long toAlloc = sequence::plusScan(charsUsedArr,charsUsedArr,n);
   uintE* iEdges = newA(uintE,toAlloc);
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
       edgePts[i] = iEdges+charsUsedArr[i];
       long charsUsed = 
 	sequentialCompressEdgeSet((uchar *)(iEdges+charsUsedArr[i]), 
 				  0, degrees[i+1]-degrees[i],
 				  i, edges + offsets[i]);
       charsUsedArr[i] = charsUsed;
-  }}
+  });
 
   // produce the total space needed for all compressed lists in chars. 
   long totalSpace = sequence::plusScan(charsUsedArr, compressionStarts, n);
@@ -271,11 +271,11 @@ uintE *parallelCompressEdges(uintE *edges, uintT *offsets, long n, long m, uintE
   float avgBitsPerEdge = (float)totalSpace*8 / (float)m; 
   cout << "Average bits per edge: " << avgBitsPerEdge << endl;
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
       long o = compressionStarts[i];
     memcpy(finalArr + o, (uchar *)(edgePts[i]), compressionStarts[i+1]-o);
     offsets[i] = o;
-  }}
+  });
   offsets[n] = totalSpace;
   free(iEdges);
   free(edgePts);
@@ -334,21 +334,21 @@ uchar *parallelCompressWeightedEdges(intEPair *edges, uintT *offsets, long n, lo
   uintT *degrees = newA(uintT, n+1);
   long *charsUsedArr = newA(long, n);
   long *compressionStarts = newA(long, n+1);
-  {parallel_for(long i=0; i<n; i++) { 
+  parallel_for(0, n, [&] (long i) { 
     degrees[i] = Degrees[i];
     charsUsedArr[i] = 2*(ceil((degrees[i] * 9) / 8) + 4); //to change
-  }}
+  });
   degrees[n] = 0;
   sequence::plusScan(degrees,degrees, n+1);
   long toAlloc = sequence::plusScan(charsUsedArr,charsUsedArr,n);
   uintE* iEdges = newA(uintE,toAlloc);
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
     edgePts[i] = iEdges+charsUsedArr[i];
     long charsUsed = 
       sequentialCompressWeightedEdgeSet((uchar *)(iEdges+charsUsedArr[i]), 0, degrees[i+1]-degrees[i],i, edges + offsets[i]);
     charsUsedArr[i] = charsUsed;
-  }}
+  });
 
   // produce the total space needed for all compressed lists in chars. 
   long totalSpace = sequence::plusScan(charsUsedArr, compressionStarts, n);
@@ -361,11 +361,11 @@ uchar *parallelCompressWeightedEdges(intEPair *edges, uintT *offsets, long n, lo
   float avgBitsPerEdge = (float)totalSpace*8 / (float)m; 
   cout << "Average bits per edge: " << avgBitsPerEdge << endl;
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
       long o = compressionStarts[i];
     memcpy(finalArr + o, (uchar *)(edgePts[i]), compressionStarts[i+1]-o);
     offsets[i] = o;
-  }}
+  });
   offsets[n] = totalSpace;
   free(iEdges);
   free(edgePts);
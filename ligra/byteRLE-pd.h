@@ -30,6 +30,7 @@
 #include <cmath>
 #include "parallel.h"
 #include "utils.h"
+#include "grainProfile.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -170,8 +171,8 @@ template <class T, class F>
       }
     }
 
-    //do remaining chunks in parallel
-    {parallel_for(long k=1;k<numChunks;k++) {
+    //do remaining chunks, in parallel from the nested cutoff on (see grainProfile.h)
+    parallel_for_edges(degree, 1, numChunks, [&] (long k) {
       long o = k*PARALLEL_DEGREE;
       long end = o+min<long>(PARALLEL_DEGREE,degree-o);
 
@@ -228,8 +229,7 @@ template <class T, class F>
 	  }
 	}
       }
-      }    
-    }
+      }, PARALLEL_DEGREE);
   }
 }
 
@@ -400,23 +400,23 @@ uintE *parallelCompressEdges(uintE *edges, uintT *offsets, long n, long m, uintE
   uintT *degrees = newA(uintT, n+1);
   long *charsUsedArr = newA(long, n);
   long *compressionStarts = newA(long, n+1);
-  {parallel_for(long i=0; i<n; i++) { 
+  parallel_for(0, n, [&] (long i) { 
       degrees[i] = Degrees[i];
       charsUsedArr[i] = 2*(ceil((degrees[i] * 9) / 8) + 4);
-  }}
+  });
   degrees[n] = 0;
   sequence::plusScan(degrees,degrees, n+1);
   long toAlloc = sequence::plusScan(charsUsedArr,charsUsedArr,n);
   uintE* iEdges = newA(uintE,toAlloc);
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
       edgePts[i] = iEdges+charsUsedArr[i];
       long charsUsed = 
 	sequentialCompressEdgeSet((uchar *)(iEdges+charsUsedArr[i]), 
 				  0, degrees[i+1]-degrees[i],
 				  i, edges + offsets[i]);
       charsUsedArr[i] = charsUsed;
-  }}
+  });
 
   // produce the total space needed for all compressed lists in chars. 
   long totalSpace = sequence::plusScan(charsUsedArr, compressionStarts, n);
@@ -429,11 +429,11 @@ uintE *parallelCompressEdges(uintE *edges, uintT *offsets, long n, long m, uintE
   float avgBitsPerEdge = (float)totalSpace*8 / (float)m; 
   cout << "Average bits per edge: " << avgBitsPerEdge << endl;
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
       long o = compressionStarts[i];
     memcpy(finalArr + o, (uchar *)(edgePts[i]), compressionStarts[i+1]-o);
     offsets[i] = o;
-  }}
+  });
   offsets[n] = totalSpace;
   free(iEdges);
   free(edgePts);
@@ -589,7 +589,7 @@ template <class T, class F>
       }
     }
 
-    {parallel_for(long k=1;k<numChunks;k++) {
+    parallel_for_edges(degree, 1, numChunks, [&] (long k) {
       long o = k*PARALLEL_DEGREE;
       long end = o+min<long>(PARALLEL_DEGREE,degree-o);
       uchar* myStart = edgeStart + pOffsets[k-1];
@@ -707,8 +707,7 @@ template <class T, class F>
 	  }
 	}
       }
-      }
-    }
+      }, PARALLEL_DEGREE);
   }
 }
 
@@ -873,21 +872,21 @@ uchar *parallelCompressWeightedEdges(intEPair *edges, uintT *offsets, long n, lo
   uintT *degrees = newA(uintT, n+1);
   long *charsUsedArr = newA(long, n);
   long *compressionStarts = newA(long, n+1);
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
     degrees[i] = Degrees[i];
     charsUsedArr[i] = 4*(ceil((degrees[i] * 9) / 8) + 4); //to change
-  }}
+  });
   degrees[n] = 0;
   sequence::plusScan(degrees,degrees, n+1);
   long toAlloc = sequence::plusScan(charsUsedArr,charsUsedArr,n);
   uintE* iEdges = newA(uintE,toAlloc);
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
     edgePts[i] = iEdges+charsUsedArr[i];
     long charsUsed =
       sequentialCompressWeightedEdgeSet((uchar *)(iEdges+charsUsedArr[i]), 0, degrees[i+1]-degrees[i],i, edges + offsets[i]);
     charsUsedArr[i] = charsUsed;
-  }}
+  });
 
   // produce the total space needed for all compressed lists in chars.
   long totalSpace = sequence::plusScan(charsUsedArr, compressionStarts, n);
@@ -900,11 +899,11 @@ uchar *parallelCompressWeightedEdges(intEPair *edges, uintT *offsets, long n, lo
   float avgBitsPerEdge = (float)totalSpace*8 / (float)m;
   cout << "Average bits per edge: " << avgBitsPerEdge << endl;
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
       long o = compressionStarts[i];
     memcpy(finalArr + o, (uchar *)(edgePts[i]), compressionStarts[i+1]-o);
     offsets[i] = o;
-  }}
+  });
   offsets[n] = totalSpace;
   free(iEdges);
   free(edgePts);
@@ -0,0 +1,245 @@
+#ifndef CACHE_SIM_H
+#define CACHE_SIM_H
+
+// Set-associative cache hierarchy model that trace.hpp can feed directly
+// instead of writing a trace file (-trace-cache). Every worker owns private
+// copies of all levels but the last one; the last level is shared by all
+// workers and protected by a lock, which is only taken on a miss in the
+// private levels. Lines are filled into every level they missed in.
+//
+// Hits and misses are counted per level, per DataType and per phase, where
+// a phase is everything between two TRACE_MARKERs and is named after the
+// id of the marker that started it.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include "traceFormat.h"
+
+enum class CachePolicy : uint8_t { LRU, RRIP };
+static inline const char* to_string(CachePolicy p) {
+	return p == CachePolicy::LRU ? "lru" : "rrip";
+}
+
+static constexpr int CacheMaxLevels = 4;
+
+struct cacheLevel {
+	long sets, ways;
+	CachePolicy policy;
+	uint64_t* tags;  // line address + 1, 0 marks an invalid way
+	uint64_t* meta;  // LRU: time of last use, RRIP: re-reference prediction
+	uint64_t clock;
+
+	void init(long size, long _ways, int lineBits, CachePolicy _policy) {
+		ways = _ways;
+		sets = std::max(1L, (size >> lineBits) / ways);
+		policy = _policy;
+		tags = (uint64_t*) calloc(sets * ways, sizeof(uint64_t));
+		meta = (uint64_t*) calloc(sets * ways, sizeof(uint64_t));
+		clock = 0;
+	}
+
+	void del() { free(tags); free(meta); }
+
+	// returns true on a hit, inserts the line on a miss
+	bool access(uint64_t line) {
+		const long base = (long)(line % sets) * ways;
+		uint64_t* t = tags + base;
+		uint64_t* m = meta + base;
+		const uint64_t tag = line + 1;
+		for(long w = 0; w < ways; w++) {
+			if(t[w] == tag) {
+				m[w] = (policy == CachePolicy::LRU) ? ++clock : 0;
+				return true;
+			}
+		}
+		long victim = 0;
+		if(policy == CachePolicy::LRU) {
+			for(long w = 0; w < ways; w++) {
+				if(t[w] == 0) { victim = w; break; }
+				if(m[w] < m[victim]) victim = w;
+			}
+			m[victim] = ++clock;
+		} else {
+			// static RRIP with 2-bit predictions: evict a distant (3) line,
+			// aging all lines until there is one; insert as long (2)
+			for(;;) {
+				long w = 0;
+				while(w < ways && t[w] != 0 && m[w] < 3) w++;
+				if(w < ways) { victim = w; break; }
+				for(w = 0; w < ways; w++) m[w]++;
+			}
+			m[victim] = 2;
+		}
+		t[victim] = tag;
+		return false;
+	}
+};
+
+struct cacheCounts {
+	uint64_t accesses[CacheMaxLevels];
+	uint64_t misses[CacheMaxLevels];
+};
+
+struct cachePhase {
+	cacheCounts types[NumDataTypes];
+	cachePhase() { for(auto& c : types) c = cacheCounts{}; }
+};
+
+struct cacheSim {
+	struct levelSpec { long size, ways; };
+	struct alignas(64) workerState {
+		cacheLevel* levels;
+		std::map<long, cachePhase> phases;
+		cachePhase* current;
+		long epoch;
+	};
+
+	std::vector<levelSpec> spec;
+	int lineBits;
+	CachePolicy policy;
+	int workers;
+	workerState* state;
+	cacheLevel shared;
+	std::mutex sharedLock;
+	std::atomic<long> phase, epoch;
+
+	static long parseSize(const char* s, char** end) {
+		long v = strtol(s, end, 10);
+		switch(**end) {
+		case 'K': case 'k': (*end)++; return v << 10;
+		case 'M': case 'm': (*end)++; return v << 20;
+		case 'G': case 'g': (*end)++; return v << 30;
+		default: return v;
+		}
+	}
+
+	// levels are given from L1 outwards as <size>:<ways>, e.g.
+	// "32K:8,1M:16,32M:16"; returns false on a malformed description
+	bool init(const char* levels, long lineSize, CachePolicy _policy, int _workers) {
+		spec.clear();
+		for(const char* s = levels; *s; ) {
+			char* end;
+			levelSpec l;
+			l.size = parseSize(s, &end);
+			if(*end != ':') return false;
+			l.ways = strtol(end + 1, &end, 10);
+			if(l.size <= 0 || l.ways <= 0) return false;
+			spec.push_back(l);
+			if(*end == ',') end++;
+			else if(*end != 0) return false;
+			s = end;
+		}
+		if(spec.empty() || spec.size() > CacheMaxLevels) return false;
+		lineBits = 0;
+		while((1L << (lineBits + 1)) <= lineSize) lineBits++;
+		policy = _policy;
+		workers = _workers;
+		const int priv = spec.size() - 1;
+		state = new workerState[workers];
+		for(int w = 0; w < workers; w++) {
+			state[w].levels = new cacheLevel[std::max(priv, 1)];
+			for(int l = 0; l < priv; l++)
+				state[w].levels[l].init(spec[l].size, spec[l].ways, lineBits, policy);
+			state[w].current = nullptr;
+			state[w].epoch = -1;
+		}
+		shared.init(spec.back().size, spec.back().ways, lineBits, policy);
+		phase.store(-1);
+		epoch.store(0);
+		return true;
+	}
+
+	// called for every TRACE_MARKER, outside of parallel loops
+	void setPhase(long id) {
+		phase.store(id);
+		epoch++;
+	}
+
+	void access(int worker, DataType data, uint64_t addr, long size) {
+		workerState& ws = state[worker];
+		const long e = epoch.load(std::memory_order_relaxed);
+		if(ws.epoch != e) {
+			ws.current = &ws.phases[phase.load()];
+			ws.epoch = e;
+		}
+		cacheCounts& c = ws.current->types[(int)data];
+		const int priv = spec.size() - 1;
+		const uint64_t last = (addr + std::max(size, 1L) - 1) >> lineBits;
+		for(uint64_t line = addr >> lineBits; line <= last; line++) {
+			int l = 0;
+			for(; l < priv; l++) {
+				c.accesses[l]++;
+				if(ws.levels[l].access(line)) break;
+				c.misses[l]++;
+			}
+			if(l < priv) continue;
+			c.accesses[priv]++;
+			std::lock_guard<std::mutex> lock(sharedLock);
+			if(!shared.access(line)) c.misses[priv]++;
+		}
+	}
+
+	static void add(cacheCounts& a, const cacheCounts& b) {
+		for(int l = 0; l < CacheMaxLevels; l++) {
+			a.accesses[l] += b.accesses[l];
+			a.misses[l] += b.misses[l];
+		}
+	}
+
+	void printRow(const std::string& phaseName, int t, const cacheCounts& c) {
+		const int levels = spec.size();
+		if(c.accesses[0] == 0) return;
+		std::cout << std::setw(6) << phaseName << std::setw(5) << to_string((DataType)t)
+			  << std::setw(14) << c.accesses[0];
+		for(int l = 0; l < levels; l++) {
+			double rate = c.accesses[l] ? 100.0 * (c.accesses[l] - c.misses[l]) / c.accesses[l] : 0.0;
+			std::cout << std::setw(9) << std::fixed << std::setprecision(2) << rate;
+		}
+		std::cout << std::setw(16) << (c.misses[levels-1] << lineBits) << std::endl;
+	}
+
+	// prints hit rates and bytes read from memory per phase and DataType
+	void report() {
+		const int levels = spec.size();
+		std::map<long, cachePhase> phases;
+		for(int w = 0; w < workers; w++)
+			for(auto& p : state[w].phases)
+				for(int t = 0; t < NumDataTypes; t++)
+					add(phases[p.first].types[t], p.second.types[t]);
+		cachePhase total;
+		for(auto& p : phases)
+			for(int t = 0; t < NumDataTypes; t++) add(total.types[t], p.second.types[t]);
+
+		std::cout << "cache simulation (" << to_string(policy) << ", " << (1L << lineBits) << "B lines):";
+		for(int l = 0; l < levels; l++)
+			std::cout << " L" << l+1 << "=" << spec[l].size << "B/" << spec[l].ways << "-way";
+		std::cout << std::endl;
+		std::cout << std::setw(6) << "phase" << std::setw(5) << "type" << std::setw(14) << "lines";
+		for(int l = 0; l < levels; l++) std::cout << std::setw(9) << "L" + std::to_string(l+1) + "%";
+		std::cout << std::setw(16) << "mem bytes" << std::endl;
+		for(auto& p : phases)
+			for(int t = 0; t < NumDataTypes; t++)
+				printRow(p.first < 0 ? "-" : std::to_string(p.first), t, p.second.types[t]);
+		for(int t = 0; t < NumDataTypes; t++) printRow("all", t, total.types[t]);
+	}
+
+	void del() {
+		for(int w = 0; w < workers; w++) {
+			for(int l = 0; l + 1 < (int)spec.size(); l++) state[w].levels[l].del();
+			delete[] state[w].levels;
+		}
+		delete[] state;
+		shared.del();
+	}
+};
+
+#endif // CACHE_SIM_H
@@ -18,37 +18,42 @@
 #include "byteRLE-pd.h"
 #endif
 #endif
+#include "functorTraits.h"
 
 namespace decode_compressed {
   template <class F>
   struct denseT {
-    bool* nextArr, *vertexArr;
-  denseT(bool* np, bool* vp) : nextArr(np), vertexArr(vp) {}
+    ulong* nextArr, *vertexArr;
+  denseT(ulong* np, ulong* vp) : nextArr(np), vertexArr(vp) {}
 #ifndef WEIGHTED
     inline bool srcTarg(F &f, const uintE &src, const uintE &target, const uintT &edgeNumber) {
-      if (vertexArr[target] && f.update(target, src)) nextArr[src] = 1;
-      return f.cond(src);
+      if (getBit(vertexArr,target) && f.update(target, src) && !functorTraits<F>::noOutput)
+	setBitAtomic(nextArr,src);
+      return checkCond(f,src);
     }
 #else
     inline bool srcTarg(F &f, const uintE &src, const uintE &target, const intE &weight, const uintT &edgeNumber) {
-      if (vertexArr[target] && f.update(target, src, weight)) nextArr[src] = 1;
-      return f.cond(src);
+      if (getBit(vertexArr,target) && f.update(target, src, weight) && !functorTraits<F>::noOutput)
+	setBitAtomic(nextArr,src);
+      return checkCond(f,src);
     }
 #endif
   };
 
   template <class F>
   struct denseForwardT {
-    bool* nextArr, *vertexArr;
-  denseForwardT(bool* np, bool* vp) : nextArr(np), vertexArr(vp) {}
+    ulong* nextArr, *vertexArr;
+  denseForwardT(ulong* np, ulong* vp) : nextArr(np), vertexArr(vp) {}
 #ifndef WEIGHTED
     inline bool srcTarg(F &f, const uintE &src, const uintE &target, const uintT &edgeNumber) {
-      if (f.cond(target) && f.updateAtomic(src,target)) nextArr[target] = 1;
+      if (checkCond(f,target) && pushUpdate(f,src,target) && !functorTraits<F>::noOutput)
+	setBitAtomic(nextArr,target);
       return true;
     }
 #else
     inline bool srcTarg(F &f, const uintE &src, const uintE &target, const intE &weight, const uintT &edgeNumber) {
-      if (f.cond(target) && f.updateAtomic(src,target, weight)) nextArr[target] = 1;
+      if (checkCond(f,target) && pushUpdate(f,src,target,weight) && !functorTraits<F>::noOutput)
+	setBitAtomic(nextArr,target);
       return true;
     }
 #endif
@@ -56,26 +61,49 @@ namespace decode_compressed {
 
   template <class F>
   struct sparseT {
-    uintT v, o;
-    uintE *outEdges;
-  sparseT(uintT vP, uintT oP, uintE *outEdgesP) : v(vP), o(oP), outEdges(outEdgesP) {}
+    uintT v;
+    uintE *out;
+  sparseT(uintT vP, uintE *outP) : v(vP), out(outP) {}
 #ifndef WEIGHTED
     inline bool srcTarg(F &f, const uintE &src, const uintE &target, const uintT &edgeNumber) {
-      if (f.cond(target) && f.updateAtomic(v, target))
-        outEdges[o + edgeNumber] = target;
-      else outEdges[o + edgeNumber] = UINT_E_MAX;
+      bool updated = checkCond(f,target) && pushUpdate(f,v,target);
+      if (!functorTraits<F>::noOutput) out[edgeNumber] = updated ? target : UINT_E_MAX;
       return true; }
 #else
     inline bool srcTarg(F &f, const uintE &src, const uintE &target, const intE &weight, const uintT &edgeNumber) {
-      if (f.cond(target) && f.updateAtomic(v, target, weight))
-        outEdges[o + edgeNumber] = target;
-      else outEdges[o + edgeNumber] = UINT_E_MAX;
+      bool updated = checkCond(f,target) && pushUpdate(f,v,target,weight);
+      if (!functorTraits<F>::noOutput) out[edgeNumber] = updated ? target : UINT_E_MAX;
       return true; }
 #endif
   };
 
+  template <class M, class F>
+  struct reduceT {
+    typedef typename M::T T;
+    ulong* vertexArr;
+    T* acc; //one per chunk of edges that may be decoded in parallel
+    bool all;
+  reduceT(ulong* vp, T* ap, bool allP) : vertexArr(vp), acc(ap), all(allP) {}
+#ifdef PD
+    inline T& chunk(const uintT &edgeNumber) { return acc[edgeNumber / PARALLEL_DEGREE]; }
+#else
+    inline T& chunk(const uintT &edgeNumber) { return acc[0]; }
+#endif
+#ifndef WEIGHTED
+    inline bool srcTarg(F &f, const uintE &src, const uintE &target, const uintT &edgeNumber) {
+      if (all || getBit(vertexArr,target)) chunk(edgeNumber) = M::combine(chunk(edgeNumber), f.map(target, src));
+      return true;
+    }
+#else
+    inline bool srcTarg(F &f, const uintE &src, const uintE &target, const intE &weight, const uintT &edgeNumber) {
+      if (all || getBit(vertexArr,target)) chunk(edgeNumber) = M::combine(chunk(edgeNumber), f.map(target, src, weight));
+      return true;
+    }
+#endif
+  };
+
   template<class V, class F>
-  inline void decodeInNghBreakEarly(V* v, long i, bool* vertexSubset, F &f, bool* next, bool parallel = 0) {
+  inline void decodeInNghBreakEarly(V* v, long i, ulong* vertexSubset, F &f, ulong* next, bool parallel = 0) {
     uintE d = v->getInDegree();
     uchar *nghArr = v->getInNeighbors();
 #ifdef WEIGHTED
@@ -86,7 +114,7 @@ namespace decode_compressed {
   }
 
   template<class V, class F>
-  inline void decodeOutNgh(V* v, long i, bool* vertexSubset, F &f, bool* next) {
+  inline void decodeOutNgh(V* v, long i, ulong* vertexSubset, F &f, ulong* next) {
     uintE d = v->getInDegree();
     uchar *nghArr = v->getOutNeighbors();
 #ifdef WEIGHTED
@@ -96,14 +124,39 @@ namespace decode_compressed {
 #endif
   }
 
+  // edges can only be decoded from the first one, so lo is 0 and hi the
+  // degree (edgeRanges is false)
   template <class V, class F>
-  inline void decodeOutNghSparse(V* v, long i, uintT o, F &f, uintE* outEdges) {
+  inline void decodeOutNghSparse(V* v, long i, uintT lo, uintT hi, F &f, uintE* out) {
     uchar *nghArr = v->getOutNeighbors();
 #ifdef WEIGHTED
-    decodeWgh(sparseT<F>(i, o, outEdges), f, nghArr, i, v->getOutDegree());
+    decodeWgh(sparseT<F>(i, out), f, nghArr, i, v->getOutDegree());
+#else
+    decode(sparseT<F>(i, out), f, nghArr, i, v->getOutDegree());
+#endif
+  }
+
+  template <class M, class V, class F>
+  inline typename M::T reduceInNgh(V* v, long i, ulong* vertexSubset, F &f, bool all) {
+    typedef typename M::T T;
+    uintT d = v->getInDegree();
+#ifdef PD
+    long chunks = (d == 0) ? 1 : 1+(d-1)/PARALLEL_DEGREE;
+#else
+    long chunks = 1;
+#endif
+    T local[16];
+    T* acc = (chunks <= 16) ? local : newA(T, chunks);
+    for (long c = 0; c < chunks; c++) acc[c] = M::identity();
+#ifdef WEIGHTED
+    decodeWgh(reduceT<M, F>(vertexSubset, acc, all), f, v->getInNeighbors(), i, d);
 #else
-    decode(sparseT<F>(i, o, outEdges), f, nghArr, i, v->getOutDegree());
+    decode(reduceT<M, F>(vertexSubset, acc, all), f, v->getInNeighbors(), i, d);
 #endif
+    T r = acc[0];
+    for (long c = 1; c < chunks; c++) r = M::combine(r, acc[c]);
+    if (acc != local) free(acc);
+    return r;
   }
 
 }
@@ -111,6 +164,7 @@ namespace decode_compressed {
 struct compressedSymmetricVertex {
   uchar* neighbors;
   uintT degree;
+  static const bool edgeRanges = false;
   uchar* getInNeighbors() { return neighbors; }
   uchar* getOutNeighbors() { return neighbors; }
   intT getInNeighbor(intT j) { return -1; } //should not be called
@@ -125,18 +179,23 @@ struct compressedSymmetricVertex {
   void del() {}
 
   template<class F>
-  inline void decodeInNghBreakEarly(long i, bool* vertexSubset, F &f, bool* next, bool parallel = 0) {
+  inline void decodeInNghBreakEarly(long i, ulong* vertexSubset, F &f, ulong* next, bool parallel = 0) {
     decode_compressed::decodeInNghBreakEarly<compressedSymmetricVertex, F>(this, i, vertexSubset, f, next, parallel);
   }
 
   template<class F>
-  inline void decodeOutNgh(long i, bool* vertexSubset, F &f, bool* next) {
+  inline void decodeOutNgh(long i, ulong* vertexSubset, F &f, ulong* next) {
     decode_compressed::decodeOutNgh<compressedSymmetricVertex, F>(this, i, vertexSubset, f, next);
   }
 
   template <class F>
-  inline void decodeOutNghSparse(long i, uintT o, F &f, uintE* outEdges) {
-    decode_compressed::decodeOutNghSparse<compressedSymmetricVertex, F>(this, i, o, f, outEdges);
+  inline void decodeOutNghSparse(long i, uintT lo, uintT hi, F &f, uintE* out) {
+    decode_compressed::decodeOutNghSparse<compressedSymmetricVertex, F>(this, i, lo, hi, f, out);
+  }
+
+  template <class M, class F>
+  inline typename M::T reduceInNgh(long i, ulong* vertexSubset, F &f, bool all) {
+    return decode_compressed::reduceInNgh<M, compressedSymmetricVertex, F>(this, i, vertexSubset, f, all);
   }
 };
 
@@ -145,6 +204,7 @@ struct compressedAsymmetricVertex {
   uchar* outNeighbors;
   uintT outDegree;
   uintT inDegree;
+  static const bool edgeRanges = false;
   uchar* getInNeighbors() { return inNeighbors; }
   uchar* getOutNeighbors() { return outNeighbors; }
   intT getInNeighbor(intT j) { return -1; } //should not be called
@@ -160,18 +220,23 @@ struct compressedAsymmetricVertex {
   void del() {}
 
   template<class F>
-  inline void decodeInNghBreakEarly(long i, bool* vertexSubset, F &f, bool* next, bool parallel = 0) {
+  inline void decodeInNghBreakEarly(long i, ulong* vertexSubset, F &f, ulong* next, bool parallel = 0) {
     decode_compressed::decodeInNghBreakEarly<compressedAsymmetricVertex, F>(this, i, vertexSubset, f, next, parallel);
   }
 
   template<class F>
-  inline void decodeOutNgh(long i, bool* vertexSubset, F &f, bool* next) {
+  inline void decodeOutNgh(long i, ulong* vertexSubset, F &f, ulong* next) {
     decode_compressed::decodeOutNgh<compressedAsymmetricVertex, F>(this, i, vertexSubset, f, next);
   }
 
   template <class F>
-  inline void decodeOutNghSparse(long i, uintT o, F &f, uintE* outEdges) {
-    decode_compressed::decodeOutNghSparse<compressedAsymmetricVertex, F>(this, i, o, f, outEdges);
+  inline void decodeOutNghSparse(long i, uintT lo, uintT hi, F &f, uintE* out) {
+    decode_compressed::decodeOutNghSparse<compressedAsymmetricVertex, F>(this, i, lo, hi, f, out);
+  }
+
+  template <class M, class F>
+  inline typename M::T reduceInNgh(long i, ulong* vertexSubset, F &f, bool all) {
+    return decode_compressed::reduceInNgh<M, compressedAsymmetricVertex, F>(this, i, vertexSubset, f, all);
   }
 };
 
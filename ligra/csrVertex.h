@@ -0,0 +1,148 @@
+#ifndef CSR_VERTEX_H
+#define CSR_VERTEX_H
+
+// Vertices of the flat CSR backend, used for uncompressed graphs when
+// compiled with CSR defined. Such a graph is only made of offsets and edge
+// arrays, plus their transposes. The vertex array is the array of offsets,
+// with one extra entry past the last vertex. A vertex finds its edges
+// through the edge arrays of its type. Each vertex takes 4 bytes (8 if
+// asymmetric, twice that with LONG) instead of 16 (24), and reading a
+// neighbor indexes the edge array instead of following a pointer per
+// vertex.
+//
+// The degree is the distance to the next entry, so a vertex is only valid
+// in place in the vertex array and must not be copied. The arrays are
+// static members, so a process has at most one CSR graph of each type.
+#include "vertex.h"
+
+#ifndef WEIGHTED
+typedef uintE csrEdge;
+#define CSR_STRIDE 1
+#else
+typedef intE csrEdge; //weights are stored in the entry after the neighbor ID
+#define CSR_STRIDE 2
+#endif
+
+struct csrSymmetricVertex {
+  uintT offset; //of the first edge
+  static csrEdge* edges;
+  static csrSymmetricVertex* vertices;
+  static const bool edgeRanges = true;
+  void del() {}
+  long id() { return this - vertices; }
+
+  csrEdge* getInNeighbors () { return edges + CSR_STRIDE*offset; }
+  csrEdge* getOutNeighbors () { return edges + CSR_STRIDE*offset; }
+  csrEdge getInNeighbor(uintT j) { return getOutNeighbor(j); }
+  csrEdge getOutNeighbor(uintT j) {
+    csrEdge* e = edges + CSR_STRIDE*(offset+j);
+    TRACE_EDGE_READ(id(), *e, e);
+    return *e;
+  }
+#ifdef WEIGHTED
+  intE getInWeight(uintT j) { return getOutWeight(j); }
+  intE getOutWeight(uintT j) {
+    csrEdge* e = edges + CSR_STRIDE*(offset+j);
+    TRACE_EDGE_READ(id(), *e, e+1);
+    return e[1];
+  }
+#endif
+
+  uintT getInDegree() { return getOutDegree(); }
+  uintT getOutDegree() { TRACE_VERTEX_READ(id(), this); return this[1].offset - offset; }
+  void flipEdges() {}
+
+  template <class F>
+  inline void decodeInNghBreakEarly(long i, ulong* vertexSubset, F &f, ulong* next, bool parallel = 0) {
+    decode_uncompressed::decodeInNghBreakEarly<csrSymmetricVertex, F>(this, i, vertexSubset, f, next, parallel);
+  }
+
+  template <class F>
+  inline void decodeOutNgh(long i, ulong* vertexSubset, F &f, ulong* next) {
+    decode_uncompressed::decodeOutNgh<csrSymmetricVertex, F>(this, i, vertexSubset, f, next);
+  }
+
+  template <class F>
+  inline void decodeOutNghSparse(long i, uintT lo, uintT hi, F &f, uintE* out) {
+    decode_uncompressed::decodeOutNghSparse<csrSymmetricVertex, F>(this, i, lo, hi, f, out);
+  }
+
+  template <class M, class F>
+  inline typename M::T reduceInNgh(long i, ulong* vertexSubset, F &f, bool all) {
+    return decode_uncompressed::reduceInNgh<M, csrSymmetricVertex, F>(this, i, vertexSubset, f, all);
+  }
+};
+
+csrEdge* csrSymmetricVertex::edges = NULL;
+csrSymmetricVertex* csrSymmetricVertex::vertices = NULL;
+
+struct csrAsymmetricVertex {
+  uintT outOffset, inOffset;
+  static csrEdge *outEdges, *inEdges;
+  static csrAsymmetricVertex* vertices;
+  static const bool edgeRanges = true;
+  void del() {}
+  long id() { return this - vertices; }
+
+  csrEdge* getInNeighbors () { return inEdges + CSR_STRIDE*inOffset; }
+  csrEdge* getOutNeighbors () { return outEdges + CSR_STRIDE*outOffset; }
+  csrEdge getInNeighbor(uintT j) {
+    csrEdge* e = inEdges + CSR_STRIDE*(inOffset+j);
+    TRACE_EDGE_READ(id(), *e, e);
+    return *e;
+  }
+  csrEdge getOutNeighbor(uintT j) {
+    csrEdge* e = outEdges + CSR_STRIDE*(outOffset+j);
+    TRACE_EDGE_READ(id(), *e, e);
+    return *e;
+  }
+#ifdef WEIGHTED
+  intE getInWeight(uintT j) {
+    csrEdge* e = inEdges + CSR_STRIDE*(inOffset+j);
+    TRACE_EDGE_READ(id(), *e, e+1);
+    return e[1];
+  }
+  intE getOutWeight(uintT j) {
+    csrEdge* e = outEdges + CSR_STRIDE*(outOffset+j);
+    TRACE_EDGE_READ(id(), *e, e+1);
+    return e[1];
+  }
+#endif
+
+  uintT getInDegree() { TRACE_VERTEX_READ(id(), this); return this[1].inOffset - inOffset; }
+  uintT getOutDegree() { TRACE_VERTEX_READ(id(), this); return this[1].outOffset - outOffset; }
+  //the edge arrays are swapped once for all vertices (see flipVertices)
+  void flipEdges() { TRACE_VERTEX_RW(id(), this); swap(outOffset, inOffset); }
+
+  template <class F>
+  inline void decodeInNghBreakEarly(long i, ulong* vertexSubset, F &f, ulong* next, bool parallel = 0) {
+    decode_uncompressed::decodeInNghBreakEarly<csrAsymmetricVertex, F>(this, i, vertexSubset, f, next, parallel);
+  }
+
+  template <class F>
+  inline void decodeOutNgh(long i, ulong* vertexSubset, F &f, ulong* next) {
+    decode_uncompressed::decodeOutNgh<csrAsymmetricVertex, F>(this, i, vertexSubset, f, next);
+  }
+
+  template <class F>
+  inline void decodeOutNghSparse(long i, uintT lo, uintT hi, F &f, uintE* out) {
+    decode_uncompressed::decodeOutNghSparse<csrAsymmetricVertex, F>(this, i, lo, hi, f, out);
+  }
+
+  template <class M, class F>
+  inline typename M::T reduceInNgh(long i, ulong* vertexSubset, F &f, bool all) {
+    return decode_uncompressed::reduceInNgh<M, csrAsymmetricVertex, F>(this, i, vertexSubset, f, all);
+  }
+};
+
+csrEdge* csrAsymmetricVertex::outEdges = NULL;
+csrEdge* csrAsymmetricVertex::inEdges = NULL;
+csrAsymmetricVertex* csrAsymmetricVertex::vertices = NULL;
+
+//transposes the n vertices of V, including the entry past the last one
+inline void flipVertices(csrAsymmetricVertex* V, long n) {
+  parallel_for(0, n+1, [&] (long i) { V[i].flipEdges(); });
+  swap(csrAsymmetricVertex::outEdges, csrAsymmetricVertex::inEdges);
+}
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef DIRECTION_PLANNER_H
+#define DIRECTION_PLANNER_H
+
+// Chooses the traversal of edgeMap calls that do not pass a threshold:
+// sparse push, dense pull (edgeMapDense) or dense push
+// (edgeMapDenseForward). The cost of a call in each mode is its work times
+// the time per unit of work measured in earlier calls made in that mode:
+//
+//   sparse         frontier + out-degrees of the frontier
+//   dense forward  frontier + out-degrees + n/16 (the bitmap scans)
+//   dense          n + m (pull stops early, which the measured time
+//                  per unit reflects)
+//
+// Until a mode has been measured its time per unit is a prior scaled to
+// the modes that have been. The priors make the first choice between sparse
+// and dense the one of the fixed threshold m/20. Dense push is tried on the
+// first dense frontier, since before it is measured it is always predicted
+// to be slower than sparse (see choose). Measurements decay, so the
+// costs follow the current computation. The planner keeps the previous
+// mode unless another one is predicted to be Hysteresis times faster.
+//
+// The planner belongs to the graph, but the measurements and the previous
+// mode are kept per functor type F of edgeMap: calls with different
+// functors, such as the forward and backward passes of BC, do different
+// work per edge and would otherwise overwrite each other's timings.
+//
+// With -plan-log every decision is printed at the end of the run.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <sys/time.h>
+#include "traceFormat.h"
+
+struct directionPlanner {
+  static constexpr double Hysteresis = 1.25;
+  static constexpr double Decay = 0.75;
+
+  struct decision {
+    int functor;
+    long frontier, outDegrees;
+    double predicted[NumTraversalModes];
+    TraversalMode mode;
+    double seconds;
+  };
+
+  // the calls of one functor type
+  struct costs {
+    double time[NumTraversalModes], work[NumTraversalModes]; // decayed totals
+    TraversalMode last;
+    int id; // in order of the first call, for the log
+  };
+
+  long n, m;
+  double prior[NumTraversalModes];
+  std::map<const void*, costs> functors; // by key<F>()
+  costs* current; // of the call planned last
+  bool logging;
+  std::vector<decision> log;
+
+  directionPlanner(long _n, long _m) : n(_n), m(_m), current(NULL), logging(false) {
+    prior[(int)TraversalMode::Sparse] = 1;
+    prior[(int)TraversalMode::DenseForward] = 1;
+    prior[(int)TraversalMode::Dense] = (double)m / (20 * (double)(n + m));
+  }
+
+  // identifies the functor type F
+  template <class F>
+  static const void* key() {
+    static const char k = 0;
+    return &k;
+  }
+
+  costs& lookup(const void* functor) {
+    auto it = functors.find(functor);
+    if (it == functors.end()) {
+      costs c;
+      for (int i = 0; i < NumTraversalModes; i++) c.time[i] = c.work[i] = 0;
+      c.last = TraversalMode::Sparse;
+      c.id = functors.size();
+      it = functors.insert(std::make_pair(functor, c)).first;
+    }
+    return it->second;
+  }
+
+  static double now() {
+    timeval t;
+    gettimeofday(&t, NULL);
+    return (double)t.tv_sec + (double)t.tv_usec / 1000000.;
+  }
+
+  void estimate(long frontier, long outDegrees, double* w) {
+    w[(int)TraversalMode::Sparse] = frontier + outDegrees;
+    w[(int)TraversalMode::DenseForward] = frontier + outDegrees + n / 16.;
+    w[(int)TraversalMode::Dense] = n + m;
+  }
+
+  // for a call with the functor key<F>(); allowed[i] says whether mode i
+  // may be chosen
+  TraversalMode choose(const void* functor, long frontier, long outDegrees, const bool* allowed) {
+    costs& c = lookup(functor);
+    current = &c;
+    double* time = c.time, *work = c.work;
+    TraversalMode& last = c.last;
+    double w[NumTraversalModes], predicted[NumTraversalModes];
+    estimate(frontier, outDegrees, w);
+    double measured = 0, priced = 0;
+    for (int i = 0; i < NumTraversalModes; i++)
+      if (work[i] > 0) { measured += time[i]; priced += prior[i] * work[i]; }
+    const double scale = priced > 0 ? measured / priced : 1;
+    int best = -1;
+    for (int i = 0; i < NumTraversalModes; i++) {
+      predicted[i] = w[i] * (work[i] > 0 ? time[i] / work[i] : prior[i] * scale);
+      if (allowed[i] && (best < 0 || predicted[i] < predicted[best])) best = i;
+    }
+    if (allowed[(int)last] && predicted[(int)last] <= Hysteresis * predicted[best]) best = (int)last;
+    // dense push does the work of sparse push and more, so with the priors
+    // it is never predicted to be faster; it is tried once instead, on the
+    // first frontier where dense pull is predicted to beat sparse
+    const int S = (int)TraversalMode::Sparse, D = (int)TraversalMode::Dense;
+    const int F = (int)TraversalMode::DenseForward;
+    if (allowed[F] && work[F] == 0 && predicted[D] < predicted[S]) best = F;
+    last = (TraversalMode)best;
+    if (logging) {
+      decision d = {c.id, frontier, outDegrees, {0}, last, 0};
+      for (int i = 0; i < NumTraversalModes; i++) d.predicted[i] = allowed[i] ? predicted[i] : -1;
+      log.push_back(d);
+    }
+    return last;
+  }
+
+  // time taken by the call planned last
+  void record(long frontier, long outDegrees, double seconds) {
+    double w[NumTraversalModes];
+    estimate(frontier, outDegrees, w);
+    costs& c = *current;
+    const int i = (int)c.last;
+    c.time[i] = Decay * c.time[i] + seconds;
+    c.work[i] = Decay * c.work[i] + w[i];
+    if (logging) log.back().seconds = seconds;
+  }
+
+  void print() {
+    long counts[NumTraversalModes] = {0};
+    std::cout << std::setw(6) << "call" << std::setw(8) << "functor" << std::setw(10) << "frontier"
+              << std::setw(12) << "edges";
+    for (int i = 0; i < NumTraversalModes; i++) std::cout << std::setw(15) << to_string((TraversalMode)i);
+    std::cout << std::setw(15) << "chosen" << std::setw(12) << "sec" << std::endl;
+    for (size_t c = 0; c < log.size(); c++) {
+      const decision& d = log[c];
+      counts[(int)d.mode]++;
+      std::cout << std::setw(6) << c << std::setw(8) << d.functor << std::setw(10) << d.frontier
+                << std::setw(12) << d.outDegrees
+                << std::scientific << std::setprecision(3);
+      for (int i = 0; i < NumTraversalModes; i++) {
+        if (d.predicted[i] < 0) std::cout << std::setw(15) << "-";
+        else std::cout << std::setw(15) << d.predicted[i];
+      }
+      std::cout << std::setw(15) << to_string(d.mode) << std::setw(12) << d.seconds
+                << std::defaultfloat << std::endl;
+    }
+    std::cout << "planned calls:";
+    for (int i = 0; i < NumTraversalModes; i++)
+      std::cout << " " << to_string((TraversalMode)i) << " " << counts[i];
+    std::cout << std::endl;
+  }
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef FUNCTOR_TRAITS_H
+#define FUNCTOR_TRAITS_H
+
+// Optional properties of edgeMap functors, declared as static members:
+//
+//   struct F {
+//     static const bool noOutput = true;
+//     ...
+//   };
+//
+// noOutput     the caller ignores edgeMap's output, so no output
+//              vertexSubset is built (edgeMap returns an empty one)
+// condTrue     cond always returns true, so it is never called
+// idempotent   update may run concurrently on the same target, so push
+//              traversals call update instead of updateAtomic
+// monotoneMin  updateAtomic lowers a value of the target and returns true
+//              whenever it did, so it may succeed several times per target
+//              in one call; edgeMap removes the duplicates from the output
+//
+// A functor without the member gets false. A functor may also declare a
+// member function void flush(), which edgeMap calls once its traversal is
+// done, e.g. to apply the values buffered by an accumulator (see
+// accumulator.h).
+#include "parallel.h"
+
+namespace functor_traits {
+#define FUNCTOR_TRAIT(name) \
+  template <class T> constexpr bool name(decltype(&T::name)) { return T::name; } \
+  template <class T> constexpr bool name(...) { return false; }
+  FUNCTOR_TRAIT(noOutput)
+  FUNCTOR_TRAIT(condTrue)
+  FUNCTOR_TRAIT(idempotent)
+  FUNCTOR_TRAIT(monotoneMin)
+#undef FUNCTOR_TRAIT
+  template <class T> auto flush(T& f, int) -> decltype(f.flush(), void()) { f.flush(); }
+  template <class T> void flush(T& f, long) {}
+}
+
+template <class F>
+struct functorTraits {
+  static const bool noOutput = functor_traits::noOutput<F>(0);
+  static const bool condTrue = functor_traits::condTrue<F>(0);
+  static const bool idempotent = functor_traits::idempotent<F>(0);
+  static const bool monotoneMin = functor_traits::monotoneMin<F>(0);
+};
+
+template <class F>
+inline bool checkCond(F &f, uintE v) {
+  return functorTraits<F>::condTrue || f.cond(v);
+}
+
+// the update of push traversals, where several sources may update a target
+template <class F>
+inline bool pushUpdate(F &f, uintE s, uintE d) {
+  return functorTraits<F>::idempotent ? f.update(s, d) : f.updateAtomic(s, d);
+}
+
+template <class F>
+inline bool pushUpdate(F &f, uintE s, uintE d, intE w) {
+  return functorTraits<F>::idempotent ? f.update(s, d, w) : f.updateAtomic(s, d, w);
+}
+
+template <class F>
+inline void flushUpdates(F &f) { functor_traits::flush(f, 0); }
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef GRAIN_PROFILE_H
+#define GRAIN_PROFILE_H
+
+// Grain sizes of the loops over vertices and edges, which depend on the
+// machine and on how fast the edges of the graph's codec are decoded.
+//
+// nestedDegree  vertices with at least this many edges have them decoded
+//               by a nested parallel loop, with tasks of about as many
+//               edges; with PD the codecs' chunks of PARALLEL_DEGREE edges
+//               are grouped into such tasks
+// taskEdges     edges per task of the dense traversals, which split the
+//               vertices into ranges of about equal degree (see
+//               degreeChunks)
+//
+// The profile is read from the file named by LIGRA_GRAIN_PROFILE, or
+// ligra.grain in the working directory, with one line per machine and
+// codec:
+//
+//   <host> <codec> <nestedDegree> <taskEdges>
+//
+// Passing -calibrate to an application times the dense traversals of its
+// input with several values of each, and stores the fastest in the file,
+// replacing the line of the machine and codec. Without a line the
+// defaults below are used.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
+#include "parallel.h"
+#include "utils.h"
+#include "numaPlacement.h"
+using namespace std;
+
+struct grainProfile {
+  long nestedDegree, taskEdges;
+  grainProfile() : nestedDegree(1000), taskEdges(1 << 14) {}
+};
+
+inline grainProfile& grains() {
+  static grainProfile g;
+  return g;
+}
+
+inline string grainProfileFile() {
+  const char* s = getenv("LIGRA_GRAIN_PROFILE");
+  return (s != NULL) ? s : "ligra.grain";
+}
+
+inline string grainHost() {
+  char h[256];
+  if (gethostname(h, sizeof(h)) != 0) return "unknown";
+  h[sizeof(h)-1] = 0;
+  return h;
+}
+
+//sets grains() from the line of this machine and codec, if any
+inline void loadGrainProfile(const string& codec) {
+  ifstream in(grainProfileFile().c_str());
+  string line, host = grainHost();
+  while (getline(in, line)) {
+    istringstream l(line);
+    string h, c;
+    grainProfile g;
+    if (l >> h >> c >> g.nestedDegree >> g.taskEdges && h == host && c == codec &&
+	g.nestedDegree > 0 && g.taskEdges > 0)
+      grains() = g;
+  }
+}
+
+//writes grains() as the line of this machine and codec
+inline void saveGrainProfile(const string& codec) {
+  string file = grainProfileFile(), host = grainHost(), line;
+  vector<string> lines;
+  {
+    ifstream in(file.c_str());
+    while (getline(in, line)) {
+      istringstream l(line);
+      string h, c;
+      if (!(l >> h >> c && h == host && c == codec)) lines.push_back(line);
+    }
+  }
+  ofstream out(file.c_str());
+  for (size_t k = 0; k < lines.size(); k++) out << lines[k] << endl;
+  out << host << " " << codec << " " << grains().nestedDegree << " " << grains().taskEdges << endl;
+  if (!out) cout << "saveGrainProfile: cannot write " << file << endl;
+}
+
+//Loop over the edges of a vertex of degree d, where each iteration
+//covers edgesPerIteration of them: serial below the nested cutoff, and
+//otherwise parallel with tasks of about nestedDegree edges.
+template <class F>
+inline void parallel_for_edges(long d, long start, long end, F f, long edgesPerIteration = 1) {
+  long c = grains().nestedDegree;
+  if (d < c) { for (long i = start; i < end; i++) f(i); }
+  else parallel_for(start, end, f, max(1L, c / edgesPerIteration));
+}
+
+//Ranges of words of the vertex bitmaps with about equal numbers of in-
+//(or out-) edges plus vertices, for the dense traversals. The range of
+//each NUMA node (see numaPlacement.h) gets the same number of chunks, so
+//parallel_for_static over the chunks still gives the workers of a node
+//its own vertices. Made on first use for the current taskEdges; the
+//chunks of both directions are swapped when the graph is transposed.
+struct degreeChunks {
+  struct bounds {
+    long* b; //chunk k is words b[k] to b[k+1]-1
+    long n, taskEdges;
+    bounds() : b(NULL), n(0), taskEdges(0) {}
+  };
+  bounds in, out;
+
+  template <class vertex>
+  static void make(bounds& c, vertex* V, long n, bool inEdges) {
+    long words = bitWords(n);
+    long* W = newA(long, words+1);
+    parallel_for(0, words, [&] (long w) {
+      long e = min(n, 64*(w+1)), s = 0;
+      for (long i = 64*w; i < e; i++)
+	s += 1 + (inEdges ? V[i].getInDegree() : V[i].getOutDegree());
+      W[w] = s;
+    });
+    W[words] = 0;
+    long total = sequence::plusScan(W, W, words+1);
+    const long nodes = numaNodes(), edges = grains().taskEdges;
+    long perNode = max((8L*getWorkers() + nodes - 1) / nodes, total / (edges*nodes));
+    perNode = max(1L, min(perNode, words / nodes));
+    free(c.b);
+    c.n = nodes*perNode;
+    c.b = newA(long, c.n+1);
+    c.taskEdges = edges;
+    parallel_for(0, c.n, [&] (long k) {
+      long node = k / perNode, j = k % perNode;
+      long lo = node*words/nodes, hi = (node+1)*words/nodes;
+      long target = W[lo] + (W[hi] - W[lo]) * j / perNode;
+      c.b[k] = lower_bound(W+lo, W+hi, target) - W;
+    });
+    c.b[c.n] = words;
+    free(W);
+  }
+
+  template <class vertex>
+  bounds& get(vertex* V, long n, bool inEdges) {
+    bounds& c = inEdges ? in : out;
+    if (c.taskEdges != grains().taskEdges) make(c, V, n, inEdges);
+    return c;
+  }
+  void flip() { swap(in, out); }
+  void del() { free(in.b); free(out.b); }
+};
+
+#endif
@@ -3,12 +3,23 @@
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>
+#include <type_traits>
 #include "vertex.h"
 #include "compressedVertex.h"
+#include "csrVertex.h"
 #include "parallel.h"
+#include "bufferPool.h"
+#include "directionPlanner.h"
+#include "grainProfile.h"
 #include "trace.hpp"
 using namespace std;
 
+#if !defined(DO_TRACE)
+// untraced vertices must not carry the trace id
+static_assert(sizeof(symmetricVertex) == sizeof(compressedSymmetricVertex), "symmetricVertex has extra fields");
+static_assert(sizeof(asymmetricVertex) == sizeof(compressedAsymmetricVertex), "asymmetricVertex has extra fields");
+#endif
+
 // **************************************************************
 //    ADJACENCY ARRAY REPRESENTATION
 // **************************************************************
@@ -20,29 +31,46 @@ public:
   virtual void del() = 0;
 };
 
+template <class vertex>
+inline void flipVertices(vertex* V, long n) {
+  parallel_for(0, n, [&] (long i) {
+    TRACE_VERTEX_RW(i, &V[i]);
+    V[i].flipEdges();
+  });
+}
+
 template <class vertex>
 struct graph {
   vertex *V;
   long n;
   long m;
   bool transposed;
-  uintE* flags;
   Deletable *D;
-graph(vertex* VV, long nn, long mm, Deletable* DD) : V(VV), n(nn), m(mm), D(DD), flags(NULL), transposed(0) {}
-graph(vertex* VV, long nn, long mm, Deletable* DD, uintE* _flags) : V(VV), n(nn), m(mm), D(DD), flags(_flags), transposed(0) {}
+  bufferPool *pool; // edgeMap scratch space, shared by all copies of the graph
+  directionPlanner *planner; // edgeMap traversal choices, shared likewise
+  degreeChunks *chunks; // vertex ranges of the dense traversals, shared likewise
+graph(vertex* VV, long nn, long mm, Deletable* DD) : V(VV), n(nn), m(mm), transposed(0), D(DD),
+    pool(new bufferPool()), planner(new directionPlanner(nn, mm)), chunks(new degreeChunks()) {}
+
+  //chunks of the pull (in-edges) or push (out-edges) traversals
+  degreeChunks::bounds& denseChunks(bool inEdges) { return chunks->get(V, n, inEdges); }
 
   void del() {
     D->del();
     free(D);
+    pool->del();
+    delete pool;
+    delete planner;
+    chunks->del();
+    delete chunks;
   }
 
   void transpose() {
     if ((sizeof(vertex) == sizeof(asymmetricVertex)) || 
-        (sizeof(vertex) == sizeof(compressedAsymmetricVertex))) {
-      parallel_for(long i=0;i<n;i++) {
-        TRACE_VERTEX_RW(i, &V[i]);
-        V[i].flipEdges();
-      }
+        (sizeof(vertex) == sizeof(compressedAsymmetricVertex)) ||
+        is_same<vertex, csrAsymmetricVertex>::value) {
+      flipVertices(V, n);
+      chunks->flip();
       transposed = !transposed;
     }
   }
@@ -40,108 +40,410 @@
 #include "parseCommandLine.h"
 #include "gettime.h"
 #include "trace.hpp"
+#include "perfCounters.h"
+#include "accumulator.h"
+#include "propagationBlocking.h"
 using namespace std;
 
 //*****START FRAMEWORK*****
 
-//options to edgeMap for different versions of dense edgeMap (default is DENSE)
-enum options { DENSE, DENSE_FORWARD };
+//options to edgeMap for different versions of dense edgeMap: pull
+//(DENSE), push (DENSE_FORWARD), or either one as chosen by the direction
+//planner (AUTO, the default; DENSE with an explicit threshold). Push is
+//blocked (edgeMapDenseForwardBlocked) if the frontier is dense and the
+//vertex arrays exceed the cache (see propagationBlocking.h), and always
+//with DENSE_FORWARD_BLOCKED
+enum options { DENSE, DENSE_FORWARD, AUTO, DENSE_FORWARD_BLOCKED };
 
+//vertexSubset and next are bitmaps (see vertexSubset.h); next is NULL if
+//F has no output (see functorTraits.h). The dense traversals split the
+//vertices into chunks of about equal degree within the range of each NUMA
+//node (see grainProfile.h and numaPlacement.h), so a vertex of high degree
+//does not hold up the vertices that would share its task
 template <class vertex, class F>
-bool* edgeMapDense(graph<vertex> GA, bool* vertexSubset, F &f, bool parallel = 0) {
+ulong* edgeMapDense(graph<vertex> GA, ulong* vertexSubset, F &f, bool parallel = 0) {
+  const bool output = !functorTraits<F>::noOutput;
   long numVertices = GA.n;
   vertex *G = GA.V;
-  bool* next = newA(bool,numVertices);
-  {parallel_for (long i=0; i<numVertices; i++) {
-    next[i] = 0;
-    if (f.cond(i)) {
-      G[i].decodeInNghBreakEarly(i, vertexSubset, f, next, parallel);
+  long words = bitWords(numVertices);
+  ulong* next = output ? newNumaA(ulong,words) : NULL;
+  degreeChunks::bounds& c = GA.denseChunks(true);
+  parallel_for_static(0, c.n, [&] (long k) {
+    for (long w = c.b[k]; w < c.b[k+1]; w++) {
+      if (output) next[w] = 0;
+      long e = min(numVertices,64*(w+1));
+      for (long i=64*w; i<e; i++)
+	if (checkCond(f,i)) {
+	  G[i].decodeInNghBreakEarly(i, vertexSubset, f, next, parallel);
+	}
     }
-  }}
+  });
   return next;
 }
 
 template <class vertex, class F>
-bool* edgeMapDenseForward(graph<vertex> GA, bool* vertexSubset, F &f) {
+ulong* edgeMapDenseForward(graph<vertex> GA, ulong* vertexSubset, F &f) {
   long numVertices = GA.n;
   vertex *G = GA.V;
-  bool* next = newA(bool,numVertices);
-  {parallel_for(long i=0;i<numVertices;i++) next[i] = 0;}
-  {parallel_for (long i=0; i<numVertices; i++){
-    if (vertexSubset[i]) {
-      G[i].decodeOutNgh(i, vertexSubset, f, next);
+  long words = bitWords(numVertices);
+  ulong* next = NULL;
+  if (!functorTraits<F>::noOutput) {
+    next = newNumaA(ulong,words);
+    parallel_for_static(0, words, [&] (long w) { next[w] = 0; });
+  }
+  degreeChunks::bounds& c = GA.denseChunks(false);
+  parallel_for_static(0, c.n, [&] (long k) {
+    for (long w = c.b[k]; w < c.b[k+1]; w++) {
+      ulong x = vertexSubset[w];
+      while (x) {
+	long i = 64*w + __builtin_ctzl(x);
+	x &= x-1;
+	G[i].decodeOutNgh(i, vertexSubset, f, next);
+      }
+    }
+  });
+  return next;
+}
+
+//edgeMapDenseForward with propagation blocking (see
+//propagationBlocking.h): the updates are binned by target, then each
+//bucket of targets is applied by one worker with update in place of
+//updateAtomic
+template <class vertex, class F>
+ulong* edgeMapDenseForwardBlocked(graph<vertex> GA, ulong* vertexSubset, F &f, long outDegrees) {
+  typedef pbUpdate<F> U;
+  const bool output = !functorTraits<F>::noOutput;
+  long numVertices = GA.n;
+  vertex *G = GA.V;
+  long words = bitWords(numVertices);
+  ulong* next = NULL;
+  if (output) {
+    next = newNumaA(ulong,words);
+    parallel_for_static(0, words, [&] (long w) { next[w] = 0; });
+  }
+  propagationBlocks<typename U::entry> pb(*GA.pool, numVertices, outDegrees);
+  pbBinF<F> bin(f, pb);
+  degreeChunks::bounds& c = GA.denseChunks(false);
+  parallel_for_static(0, c.n, [&] (long k) {
+    for (long w = c.b[k]; w < c.b[k+1]; w++) {
+      ulong x = vertexSubset[w];
+      while (x) {
+	long i = 64*w + __builtin_ctzl(x);
+	x &= x-1;
+	G[i].decodeOutNgh(i, vertexSubset, bin, NULL);
+      }
     }
-  }}
+  });
+  pb.close();
+  pb.apply([&] (const typename U::entry& e) {
+    if (checkCond(f, e.d) && U::apply(f, e) && output)
+      setBit(next, e.d); //the words of a bucket's targets belong to it
+  });
+  pb.del();
   return next;
 }
 
+//edges per block of edgeMapSparse
+#define SPARSE_BLOCK 2048
+
+//Splits the frontier's out-edges into blocks of SPARSE_BLOCK edges, so
+//vertices of high degree are spread over several blocks. Each block
+//collects its updated targets in a local buffer and appends them to the
+//buffer of its worker, and the worker buffers are then copied into the
+//output, so the memory used is proportional to the output rather than to
+//the edges traversed. Vertices whose edges can only be decoded in order
+//(edgeRanges is false) are not split, but handled by the block holding
+//their first edge. If flags is given, duplicates are removed. Nothing is
+//collected if F has no output.
 template <class vertex, class F>
-pair<long,uintE*> edgeMapSparse(vertex* frontierVertices, uintE* indices, 
-        uintT* degrees, uintT m, F &f, 
-        long remDups=0, uintE* flags=NULL) {
+pair<long,uintE*> edgeMapSparse(bufferPool& pool, vertex* G, uintE* indices, 
+        uintT* degrees, uintT m, F &f, uintE* flags=NULL) {
   uintT* offsets = degrees;
   long outEdgeCount = sequence::plusScan(offsets, degrees, m);
-  uintE* outEdges = newA(uintE,outEdgeCount);
-  {parallel_for (long i = 0; i < m; i++) {
-      uintT v = indices[i], o = offsets[i];
-      vertex vert = frontierVertices[i]; 
-      vert.decodeOutNghSparse(v, o, f, outEdges);
-    }}
-  uintE* nextIndices = newA(uintE, outEdgeCount);
-  if(remDups) remDuplicates(outEdges,flags,outEdgeCount,remDups);
-  // Filter out the empty slots (marked with -1)
-  long nextM = sequence::filter(outEdges,nextIndices,outEdgeCount,nonMaxF());
-  free(outEdges);
-  return pair<long,uintE*>(nextM, nextIndices);
+  long numBlocks = (outEdgeCount + SPARSE_BLOCK - 1) / SPARSE_BLOCK;
+  bufferPool::workerBuffer* workers = pool.workerBuffers();
+  long* counts = pool.get<long>(numBlocks);
+  long* starts = pool.get<long>(numBlocks); //position in the worker's buffer
+  int* owners = pool.get<int>(numBlocks);
+  parallel_for(0, numBlocks, [&] (long b) {
+      long s = b*SPARSE_BLOCK, e = min(s + SPARSE_BLOCK, outEdgeCount);
+      //first vertex with edges in the block, and the end of the block's edges
+      long k = vertex::edgeRanges ? (upper_bound(offsets, offsets+m, (uintT)s) - offsets) - 1
+	: lower_bound(offsets, offsets+m, (uintT)s) - offsets;
+      long kEnd = lower_bound(offsets+k, offsets+m, (uintT)e) - offsets;
+      if (!vertex::edgeRanges) {
+	s = (k < m) ? offsets[k] : outEdgeCount;
+	e = (kEnd < m) ? offsets[kEnd] : outEdgeCount;
+      }
+      uintE local[SPARSE_BLOCK];
+      uintE* out = (e - s <= SPARSE_BLOCK) ? local : newA(uintE, e - s);
+      for (; k < kEnd; k++) {
+	long o = offsets[k], d = ((k+1 < m) ? offsets[k+1] : outEdgeCount) - o;
+	long lo = max(s, o) - o, hi = min(e, o + d) - o;
+	if (hi > lo) G[indices[k]].decodeOutNghSparse(indices[k], lo, hi, f, out + o + lo - s);
+      }
+      long c = 0;
+      if (!functorTraits<F>::noOutput) for (long j = 0; j < e - s; j++) {
+	uintE ngh = out[j];
+	if (ngh != UINT_E_MAX && (flags == NULL || 
+				  CAS(&flags[ngh], (uintE)UINT_E_MAX, (uintE)0)))
+	  out[c++] = ngh;
+      }
+      int w = getWorkerNum();
+      owners[b] = w;
+      starts[b] = workers[w].n;
+      counts[b] = c;
+      pool.append(w, out, c);
+      if (out != local) free(out);
+    });
+  long nextM = sequence::plusScan(counts, counts, numBlocks);
+  uintE* next = newA(uintE, nextM);
+  parallel_for(0, numBlocks, [&] (long b) {
+      long c = ((b+1 < numBlocks) ? counts[b+1] : nextM) - counts[b];
+      uintE* A = workers[owners[b]].A + starts[b];
+      for (long j = 0; j < c; j++) next[counts[b] + j] = A[j];
+    });
+  if (flags != NULL) {parallel_for(0, nextM, [&] (long i) { flags[next[i]] = UINT_E_MAX; });}
+  pool.put(counts);
+  pool.put(starts);
+  pool.put(owners);
+  return pair<long,uintE*>(nextM, next);
+}
+
+//F for traversals run by a single worker, where the update of a target
+//need not be atomic
+template <class F>
+struct serialF : F {
+  serialF(const F& f) : F(f) {}
+  inline bool updateAtomic(uintE s, uintE d) { return F::update(s, d); }
+  inline bool updateAtomic(uintE s, uintE d, intE w) { return F::update(s, d, w); }
+};
+
+//frontiers with at most this many vertices plus out-edges are traversed
+//by edgeMapSerial
+#define SERIAL_EDGEMAP 2048
+
+//Sparse edgeMap of a small frontier, run by the calling worker alone: no
+//tasks are spawned, the targets are collected on the stack, and updates
+//are not atomic. Only the output is allocated. outDegrees must be at most
+//SERIAL_EDGEMAP. If flags is given, duplicates are removed.
+template <class vertex, class F>
+pair<long,uintE*> edgeMapSerial(vertex* G, uintE* indices, uintT m, 
+        uintT outDegrees, F &f, uintE* flags=NULL) {
+  serialF<F> h(f);
+  uintE out[SERIAL_EDGEMAP];
+  for (long k = 0, o = 0; k < m; k++) {
+    uintT d = G[indices[k]].getOutDegree();
+    if (d > 0) G[indices[k]].decodeOutNghSparse(indices[k], 0, d, h, out + o);
+    o += d;
+  }
+  if (functorTraits<F>::noOutput) return pair<long,uintE*>(0, NULL);
+  long c = 0;
+  for (long j = 0; j < outDegrees; j++) {
+    uintE ngh = out[j];
+    if (ngh != UINT_E_MAX && (flags == NULL || flags[ngh] == UINT_E_MAX)) {
+      if (flags != NULL) flags[ngh] = 0;
+      out[c++] = ngh;
+    }
+  }
+  uintE* next = newA(uintE, c);
+  for (long j = 0; j < c; j++) {
+    next[j] = out[j];
+    if (flags != NULL) flags[out[j]] = UINT_E_MAX;
+  }
+  return pair<long,uintE*>(c, next);
 }
 
 // decides on sparse or dense base on number of nonzeros in the active vertices
 template <class vertex, class F>
 vertexSubset edgeMap(graph<vertex> GA, vertexSubset &V, F f, intT threshold = -1, 
-		 char option=DENSE, bool remDups=false) {
-  long numVertices = GA.n, numEdges = GA.m;
-  if(threshold == -1) threshold = numEdges/20; //default threshold
+		 char option=AUTO, bool remDups=false) {
+  TRACE_CALL_START(traceStart);
+  PERF_CALL_START(perfStart);
+  long numVertices = GA.n;
+  //without a threshold the direction planner chooses the traversal
+  const bool planned = threshold == -1;
   vertex *G = GA.V;
+  bufferPool& pool = *GA.pool;
   long m = V.numNonzeros();
   if (numVertices != V.numRows()) {
     cout << "edgeMap: Sizes Don't match" << endl;
     abort();
   }
-  // used to generate nonzero indices to get degrees
-  uintT* degrees = newA(uintT, m);
-  vertex* frontierVertices;
+  //small frontiers skip the planner, unless a threshold asks for dense
+  if (m <= SERIAL_EDGEMAP) {
+    V.toSparse();
+    long outDegrees = 0;
+    for (long i = 0; i < m && m + outDegrees <= SERIAL_EDGEMAP; i++) {
+      TRACE_VERTEX_READ(V.s[i], &G[V.s[i]]);
+      outDegrees += G[V.s[i]].getOutDegree();
+    }
+    if (m + outDegrees <= SERIAL_EDGEMAP && (planned || m + outDegrees <= threshold)) {
+      pair<long,uintE*> R = 
+	(remDups || functorTraits<F>::monotoneMin) ? 
+	edgeMapSerial(G, V.s, m, outDegrees, f, pool.dedupFlags(numVertices)) :
+	edgeMapSerial(G, V.s, m, outDegrees, f);
+      flushUpdates(f);
+      vertexSubset out(numVertices);
+      if (!functorTraits<F>::noOutput) out = vertexSubset(numVertices, R.first, R.second);
+      TRACE_EDGEMAP(TraversalMode::Sparse, m, outDegrees, planned ? 0 : threshold, out.m, traceStart);
+      PERF_EDGEMAP(TraversalMode::Sparse, m, outDegrees, perfStart);
+      return out;
+    }
+  }
+  // used to generate nonzero indices to get degrees; vertices are used in
+  // place, since CSR vertices cannot be copied (see csrVertex.h)
+  uintT* degrees = pool.get<uintT>(m);
   V.toSparse();
-  frontierVertices = newA(vertex,m);
-  {parallel_for (long i=0; i < m; i++){
+  parallel_for(0, m, [&] (long i) {
     const auto vertex_id = V.s[i];
     TRACE_VERTEX_READ(vertex_id, &G[vertex_id]);
-    vertex v = G[vertex_id];
-    degrees[i] = v.getOutDegree();
-    frontierVertices[i] = v;
-    }}
+    degrees[i] = G[vertex_id].getOutDegree();
+    });
   uintT outDegrees = sequence::plusReduce(degrees, m);
-  if (outDegrees == 0) return vertexSubset(numVertices);
-  if (m + outDegrees > threshold) { 
+  if (outDegrees == 0) {
+    pool.put(degrees);
+    TRACE_EDGEMAP(TraversalMode::Sparse, m, 0, planned ? 0 : threshold, 0, traceStart);
+    PERF_EDGEMAP(TraversalMode::Sparse, m, 0, perfStart);
+    return vertexSubset(numVertices);
+  }
+  const bool forward = option == DENSE_FORWARD || option == DENSE_FORWARD_BLOCKED;
+  TraversalMode mode;
+  if (planned) {
+    const bool allowed[NumTraversalModes] = {true, !forward, option != DENSE};
+    mode = GA.planner->choose(directionPlanner::key<F>(), m, outDegrees, allowed);
+  } else if (m + outDegrees > threshold)
+    mode = forward ? TraversalMode::DenseForward : TraversalMode::Dense;
+  else mode = TraversalMode::Sparse;
+  const double start = planned ? directionPlanner::now() : 0;
+  vertexSubset out(numVertices);
+  if (mode != TraversalMode::Sparse) { 
     V.toDense();
-    free(degrees);
-    free(frontierVertices);
-    bool* R = (option == DENSE_FORWARD) ? 
-      edgeMapDenseForward(GA,V.d,f) : 
-      edgeMapDense(GA, V.d, f, option);
-    vertexSubset v1 = vertexSubset(numVertices, R);
-    //cout << "size (D) = " << v1.m << endl;
-    return v1;
+    pool.put(degrees);
+    ulong* R = (mode != TraversalMode::DenseForward) ? 
+      edgeMapDense(GA, V.d, f) :
+      (option == DENSE_FORWARD_BLOCKED || propagationBlockingPays(numVertices, outDegrees)) ?
+      edgeMapDenseForwardBlocked(GA, V.d, f, outDegrees) :
+      edgeMapDenseForward(GA,V.d,f);
+    if (R != NULL) out = vertexSubset::fromBits(numVertices, R);
+    //cout << "size (D) = " << out.m << endl;
   } else { 
     pair<long,uintE*> R = 
-      remDups ? 
-      edgeMapSparse(frontierVertices, V.s, degrees, V.numNonzeros(), f, 
-		    numVertices, GA.flags) :
-      edgeMapSparse(frontierVertices, V.s, degrees, V.numNonzeros(), f);
+      (remDups || functorTraits<F>::monotoneMin) ? 
+      edgeMapSparse(pool, G, V.s, degrees, V.numNonzeros(), f, 
+		    pool.dedupFlags(numVertices)) :
+      edgeMapSparse(pool, G, V.s, degrees, V.numNonzeros(), f);
     //cout << "size (S) = " << R.first << endl;
-    free(degrees);
-    free(frontierVertices);
-    return vertexSubset(numVertices, R.first, R.second);
+    pool.put(degrees);
+    if (functorTraits<F>::noOutput) free(R.second);
+    else out = vertexSubset(numVertices, R.first, R.second);
+  }
+  flushUpdates(f);
+  if (planned) GA.planner->record(m, outDegrees, directionPlanner::now() - start);
+  TRACE_EDGEMAP(mode, m, outDegrees, planned ? 0 : threshold, out.m, traceStart);
+  PERF_EDGEMAP(mode, m, outDegrees, perfStart);
+  return out;
+}
+
+//F with its output dropped (see functorTraits.h)
+template <class F>
+struct noOutputF : F {
+  static const bool noOutput = true;
+  noOutputF(const F& f) : F(f) {}
+};
+
+//Dense edgeMap (pull) fused with a vertexMap over the targets: each vertex
+//i with f.cond(i) pulls from its in-neighbors in V with f.update, and g(i)
+//is applied right after, while the values of i are still in cache. This
+//replaces an edgeMap followed by vertexMaps over all vertices. The results
+//of g are added to init and returned; no output vertexSubset is built.
+template <class vertex, class F, class VF, class E>
+E edgeMapVertexMap(graph<vertex> GA, vertexSubset &V, F f, VF g, E init) {
+  TRACE_CALL_START(traceStart);
+  PERF_CALL_START(perfStart);
+  long numVertices = GA.n;
+  vertex *G = GA.V;
+  bufferPool& pool = *GA.pool;
+  if (numVertices != V.numRows()) {
+    cout << "edgeMapVertexMap: Sizes Don't match" << endl;
+    abort();
+  }
+  long m = V.numNonzeros();
+  V.toDense();
+  noOutputF<F> h(f);
+  degreeChunks::bounds& c = GA.denseChunks(true);
+  E* sums = pool.get<E>(c.n);
+  parallel_for_static(0, c.n, [&] (long k) {
+    E s = 0;
+    long e = min(numVertices,64*c.b[k+1]);
+    for (long i=64*c.b[k]; i<e; i++)
+      if (checkCond(h,i)) {
+	G[i].decodeInNghBreakEarly(i, V.d, h, (ulong*)NULL);
+	s += g(i);
+      }
+    sums[k] = s;
+  });
+  E total = sequence::plusReduce(sums, c.n);
+  pool.put(sums);
+  //out-degrees are not summed for the trace, since no traversal is chosen
+  TRACE_EDGEMAP(TraversalMode::Dense, m, 0, 0, 0, traceStart);
+  PERF_EDGEMAP(TraversalMode::Dense, m, 0, perfStart);
+  return init + total;
+}
+
+//true if V and its out-edges are more than threshold (by default a
+//twentieth of the edges, the usual dense threshold of edgeMap). Since
+//edgeMapVertexMap visits the in-edges of every vertex, apps call it only
+//for frontiers where this holds, and traverse smaller ones with edgeMap
+template <class vertex>
+bool denseFrontier(graph<vertex> GA, vertexSubset &V, long threshold = -1) {
+  if (threshold == -1) threshold = GA.m/20;
+  long m = V.numNonzeros();
+  if (m == 0) return false;
+  if (m > threshold) return true;
+  V.toSparse();
+  vertex *G = GA.V;
+  long outDegrees = sequence::reduce<long>((long)0, m, addF<long>(), 
+    [&] (long i) { return (long)G[V.s[i]].getOutDegree(); });
+  return m + outDegrees > threshold;
+}
+
+//Dense edgeMap as a matrix-vector product over the monoid M (see
+//utils.h): each vertex i with f.cond(i) combines f.map(s,i) (f.map(s,i,w)
+//if weighted) over its in-neighbors s in V, and passes the result to
+//f.apply(i,r). Nothing is written per edge, so no atomics are needed, and
+//if V holds all vertices the inner loop does not test V and can be
+//vectorized. The results of apply are added to init and returned; no
+//output vertexSubset is built.
+template <class M, class vertex, class F, class E>
+E edgeMapReduce(graph<vertex> GA, vertexSubset &V, F f, E init) {
+  TRACE_CALL_START(traceStart);
+  PERF_CALL_START(perfStart);
+  long numVertices = GA.n;
+  vertex *G = GA.V;
+  bufferPool& pool = *GA.pool;
+  if (numVertices != V.numRows()) {
+    cout << "edgeMapReduce: Sizes Don't match" << endl;
+    abort();
   }
+  long m = V.numNonzeros();
+  const bool all = m == numVertices;
+  V.toDense();
+  degreeChunks::bounds& c = GA.denseChunks(true);
+  E* sums = pool.get<E>(c.n);
+  parallel_for_static(0, c.n, [&] (long k) {
+    E s = 0;
+    long e = min(numVertices,64*c.b[k+1]);
+    for (long i=64*c.b[k]; i<e; i++)
+      if (checkCond(f,i))
+	s += f.apply(i, G[i].template reduceInNgh<M>(i, V.d, f, all));
+    sums[k] = s;
+  });
+  E total = sequence::plusReduce(sums, c.n);
+  pool.put(sums);
+  TRACE_EDGEMAP(TraversalMode::Dense, m, 0, 0, 0, traceStart);
+  PERF_EDGEMAP(TraversalMode::Dense, m, 0, perfStart);
+  return init + total;
 }
 
 //*****VERTEX FUNCTIONS*****
@@ -150,27 +452,47 @@ vertexSubset edgeMap(graph<vertex> GA, vertexSubset &V, F f, intT threshold = -1
 //perform a filter
 template <class F>
 void vertexMap(vertexSubset V, F add) {
+  TRACE_CALL_START(traceStart);
+  PERF_CALL_START(perfStart);
   long n = V.numRows(), m = V.numNonzeros();
   if(V.isDense) {
-    {parallel_for(long i=0;i<n;i++)
-	if(V.d[i]) add(i);}
+    long words = bitWords(n);
+    parallel_for_static(0, words, [&] (long w) {
+	ulong x = V.d[w];
+	while (x) { add(64*w + __builtin_ctzl(x)); x &= x-1; }
+      });
   } else {
-    {parallel_for(long i=0;i<m;i++)
-	add(V.s[i]);}
+    parallel_for(0, m, [&] (long i) {
+	add(V.s[i]);
+    });
   }
+  TRACE_VERTEXMAP(V.isDense, m, traceStart);
+  PERF_VERTEXMAP(V.isDense, m, perfStart);
 }
 
 //Note: this is the version of vertexMap in which only a subset of the
 //input vertexSubset is returned
 template <class F>
 vertexSubset vertexFilter(vertexSubset V, F filter) {
+  TRACE_CALL_START(traceStart);
+  PERF_CALL_START(perfStart);
   long n = V.numRows(), m = V.numNonzeros();
   V.toDense();
-  bool* d_out = newA(bool,n);
-  {parallel_for(long i=0;i<n;i++) d_out[i] = 0;}
-  {parallel_for(long i=0;i<n;i++)
-      if(V.d[i]) d_out[i] = filter(i);}
-  return vertexSubset(n,d_out);
+  long words = bitWords(n);
+  ulong* d_out = newNumaA(ulong,words);
+  parallel_for_static(0, words, [&] (long w) {
+      ulong x = V.d[w], y = 0;
+      while (x) {
+	long i = 64*w + __builtin_ctzl(x);
+	x &= x-1;
+	if(filter(i)) y |= 1UL << (i & 63);
+      }
+      d_out[w] = y;
+    });
+  vertexSubset out = vertexSubset::fromBits(n,d_out);
+  TRACE_VERTEXFILTER(m, out.m, traceStart);
+  PERF_VERTEXFILTER(m, perfStart);
+  return out;
 }
 
 //cond function that always returns true
@@ -186,6 +508,107 @@ void Compute(graph<vertex>&, commandLine);
 #define STR(s) STR_(s)
 
 
+//name of the codec of vertex in the grain profile (see grainProfile.h)
+template <class vertex>
+string codecName() {
+  if (is_same<vertex, symmetricVertex>::value || is_same<vertex, asymmetricVertex>::value)
+    return "uncompressed";
+  if (is_same<vertex, csrSymmetricVertex>::value || is_same<vertex, csrAsymmetricVertex>::value)
+    return "csr";
+#ifdef BYTE
+  string codec = "byte";
+#elif defined NIBBLE
+  string codec = "nibble";
+#else
+  string codec = "byteRLE";
+#endif
+#ifdef PD
+  codec += "-pd";
+#endif
+  return codec;
+}
+
+//functor of the calibration, which reads every edge and writes its target
+struct grainF {
+  uintE* A;
+  static const bool noOutput = true, condTrue = true, idempotent = true;
+  grainF(uintE* _A) : A(_A) {}
+  inline bool update(uintE s, uintE d) { A[d] = s; return 0; }
+  inline bool updateAtomic(uintE s, uintE d) { A[d] = s; return 0; }
+  inline bool update(uintE s, uintE d, intE w) { A[d] = s; return 0; }
+  inline bool updateAtomic(uintE s, uintE d, intE w) { A[d] = s; return 0; }
+  inline bool cond(uintE d) { return 1; }
+};
+
+//sets *g to the value of values for which run is fastest, best of three
+//runs each after an untimed one
+template <class R>
+void fastestGrain(long* g, const long* values, int k, R run) {
+  long best = values[0];
+  double bestTime = 1e300;
+  for (int j = 0; j < k; j++) {
+    *g = values[j];
+    run();
+    double t = 1e300;
+    for (int r = 0; r < 3; r++) {
+      double start = directionPlanner::now();
+      run();
+      t = min(t, directionPlanner::now() - start);
+    }
+    if (t < bestTime) { bestTime = t; best = values[j]; }
+  }
+  *g = best;
+}
+
+//times the dense traversals of G over all vertices with several grain
+//sizes, and keeps the fastest in grains(): taskEdges with the pull
+//traversal, then nestedDegree with both
+template <class vertex>
+void calibrateGrains(graph<vertex>& G) {
+  long n = G.n;
+  uintE* A = newA(uintE, n);
+  bool* all = newA(bool, n);
+  parallel_for(0, n, [&] (long i) { all[i] = 1; });
+  vertexSubset Frontier(n, n, all);
+  Frontier.toDense();
+  grainF f(A);
+  const long taskEdges[] = {1 << 10, 1 << 12, 1 << 14, 1 << 16, 1 << 18};
+  fastestGrain(&grains().taskEdges, taskEdges, 5, [&] () { edgeMapDense(G, Frontier.d, f); });
+  const long nestedDegree[] = {250, 1000, 4000, 16000, 64000};
+  fastestGrain(&grains().nestedDegree, nestedDegree, 5, [&] () {
+    edgeMapDense(G, Frontier.d, f);
+    edgeMapDenseForward(G, Frontier.d, f);
+  });
+  cout << "grains of " << codecName<vertex>() << ": nestedDegree " << grains().nestedDegree
+       << " taskEdges " << grains().taskEdges << endl;
+  Frontier.del();
+  free(A);
+}
+
+//runs Compute once untimed, then rounds timed times, and frees G. The
+//grain sizes of the graph's codec are read from the grain profile, or
+//calibrated and stored in it with -calibrate
+template <class vertex>
+void runCompute(graph<vertex>& G, commandLine& P, long rounds) {
+  G.planner->logging = P.getOption("-plan-log");
+  loadGrainProfile(codecName<vertex>());
+  if (P.getOption("-calibrate")) {
+    calibrateGrains(G);
+    saveGrainProfile(codecName<vertex>());
+  }
+  Compute(G,P);
+  if(G.transposed) G.transpose();
+  for(int r=0;r<rounds;r++) {
+    startTime();
+    Compute(G,P);
+    nextTime("Running time");
+    if(G.transposed) G.transpose();
+  }
+  if(P.getOption("-pool-stats")) G.pool->print();
+  if(G.planner->logging) G.planner->print();
+  G.del();
+}
+
 int parallel_main(int argc, char* argv[]) {
   commandLine P(argc,argv," [-s] <inFile>");
   char* iFile = P.getArgument(0);
@@ -193,56 +616,44 @@ int parallel_main(int argc, char* argv[]) {
   bool compressed = P.getOptionValue("-c");
   bool binary = P.getOptionValue("-b");
   long rounds = P.getOptionLongValue("-rounds",3);
-  TRACE_OPEN(STR(PROJECT_NAME) ".trace");
+  //the counters are opened before anything starts the workers (as
+  //TRACE_OPEN does), so that the workers inherit them
+  PERF_OPEN(P);
+  TRACE_OPEN(STR(PROJECT_NAME) ".trace", P);
   if (compressed) {
     if (symmetric) {
       graph<compressedSymmetricVertex> G =
         readCompressedGraph<compressedSymmetricVertex>(iFile,symmetric); //symmetric graph
-      Compute(G,P);
-      for(int r=0;r<rounds;r++) {
-        startTime();
-        Compute(G,P);
-        nextTime("Running time");
-      }
-      G.del();
+      runCompute(G,P,rounds);
     } else {
       graph<compressedAsymmetricVertex> G =
         readCompressedGraph<compressedAsymmetricVertex>(iFile,symmetric); //asymmetric graph
-      Compute(G,P);
-      if(G.transposed) G.transpose();
-      for(int r=0;r<rounds;r++) {
-        startTime();
-        Compute(G,P);
-        nextTime("Running time");
-        if(G.transposed) G.transpose();
-      }
-      G.del();
+      runCompute(G,P,rounds);
     }
   } else {
+#ifdef CSR
+    if (symmetric) {
+      graph<csrSymmetricVertex> G =
+        toCSR(readGraph<symmetricVertex>(iFile,compressed,symmetric,binary)); //symmetric graph
+      runCompute(G,P,rounds);
+    } else {
+      graph<csrAsymmetricVertex> G =
+        toCSR(readGraph<asymmetricVertex>(iFile,compressed,symmetric,binary)); //asymmetric graph
+      runCompute(G,P,rounds);
+    }
+#else
     if (symmetric) {
       graph<symmetricVertex> G =
         readGraph<symmetricVertex>(iFile,compressed,symmetric,binary); //symmetric graph
-      Compute(G,P);
-      for(int r=0;r<rounds;r++) {
-        startTime();
-        Compute(G,P);
-        nextTime("Running time");
-      }
-      G.del();
+      runCompute(G,P,rounds);
     } else {
       graph<asymmetricVertex> G =
         readGraph<asymmetricVertex>(iFile,compressed,symmetric,binary); //asymmetric graph
-      Compute(G,P);
-      if(G.transposed) G.transpose();
-      for(int r=0;r<rounds;r++) {
-        startTime();
-        Compute(G,P);
-        nextTime("Running time");
-        if(G.transposed) G.transpose();
-      }
-      G.del();
+      runCompute(G,P,rounds);
     }
+#endif
   }
+  PERF_FINISH();
   TRACE_FINISH();
 }
 #endif
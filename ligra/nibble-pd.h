@@ -32,6 +32,7 @@ typedef unsigned char uchar;
 #include <cmath>
 #include "parallel.h"
 #include "utils.h"
+#include "grainProfile.h"
 #include "graph.h"
 #include <stdio.h>
 #include <string.h>
@@ -128,8 +129,8 @@ template <class T, class F>
       startEdge = edge;
       if(!t.srcTarg(f, source,startEdge,edgeID)) return;
     }
-    //do remaining chunks in parallel
-    parallel_for(long i=1;i<numChunks;i++) {
+    //do remaining chunks, in parallel from the nested cutoff on (see grainProfile.h)
+    parallel_for_edges(degree, 1, numChunks, [&] (long i) {
       long o = i*PARALLEL_DEGREE;
       long end = min<long>(o+PARALLEL_DEGREE,degree);
       // Eat first edge, which is compressed specially 
@@ -143,7 +144,7 @@ template <class T, class F>
 	startEdge = edge;
 	if(!t.srcTarg(f, source,startEdge,edgeID)) break;
       }
-    }   
+    }, PARALLEL_DEGREE);   
   }
 }
 
@@ -169,8 +170,8 @@ template <class T, class F>
       intE weight = decode_first_edge(start,&location,0);
       if(!t.srcTarg(f, source,startEdge,weight,edgeID)) return;
     }
-    //do remaining chunks in parallel
-    parallel_for(long i=1;i<numChunks;i++) {
+    //do remaining chunks, in parallel from the nested cutoff on (see grainProfile.h)
+    parallel_for_edges(degree, 1, numChunks, [&] (long i) {
       long o = i*PARALLEL_DEGREE;
       long end = min<long>(o+PARALLEL_DEGREE,degree);
       long location = pOffsets[i-1];
@@ -185,7 +186,7 @@ template <class T, class F>
 	intE weight = decode_first_edge(edgeStart,&location,0);
 	if(!t.srcTarg(f, source, edge, weight, edgeID)) break;
       }
-    }
+    }, PARALLEL_DEGREE);
   }
 }
 
@@ -244,15 +245,15 @@ uintE *parallelCompressEdges(uintE *edges, uintT *offsets, long n, long m, uintE
   uintT *degrees = newA(uintT, n+1);
   long *charsUsedArr = newA(long, n);
   long *compressionStarts = newA(long, n+1);
-  {parallel_for(long i=0; i<n; i++) { 
+  parallel_for(0, n, [&] (long i) { 
     degrees[i] = Degrees[i];
     charsUsedArr[i] = ceil((degrees[i] * 9) / 8) + 4;
-  }}
+  });
   degrees[n] = 0;
   sequence::plusScan(degrees,degrees, n+1);
   long toAlloc = sequence::plusScan(charsUsedArr,charsUsedArr,n);
   uintE* iEdges = newA(uintE,toAlloc);
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
       edgePts[i] = iEdges+charsUsedArr[i];
       long charsUsed = 
 	sequentialCompressEdgeSet((uchar *)(iEdges+charsUsedArr[i]), 
@@ -262,7 +263,7 @@ uintE *parallelCompressEdges(uintE *edges, uintT *offsets, long n, long m, uintE
       //byte-aligned
       charsUsed = (charsUsed+1) / 2;
       charsUsedArr[i] = charsUsed; 
-  }}
+  });
   long totalSpace = sequence::plusScan(charsUsedArr, compressionStarts, n);
   compressionStarts[n] = totalSpace; // in bytes
   free(degrees);
@@ -273,11 +274,11 @@ uintE *parallelCompressEdges(uintE *edges, uintT *offsets, long n, long m, uintE
   float avgBitsPerEdge = (float)totalSpace*8 / (float)m; 
   cout << "Average bits per edge: " << avgBitsPerEdge << endl;
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
       long o = compressionStarts[i];
     memcpy(finalArr + o, (uchar *)(edgePts[i]), compressionStarts[i+1]-o);
     offsets[i] = o;
-  }}
+  });
   offsets[n] = totalSpace;
   free(iEdges);
   free(edgePts);
@@ -360,15 +361,15 @@ uchar *parallelCompressWeightedEdges(intEPair *edges, uintT *offsets, long n, lo
   uintT *degrees = newA(uintT, n+1);
   long *charsUsedArr = newA(long, n);
   long *compressionStarts = newA(long, n+1);
-  {parallel_for(long i=0; i<n; i++) { 
+  parallel_for(0, n, [&] (long i) { 
     degrees[i] = Degrees[i];
     charsUsedArr[i] = 2*(ceil((degrees[i] * 9) / 8) + 4); //to change
-  }}
+  });
   degrees[n] = 0;
   sequence::plusScan(degrees,degrees, n+1);
   long toAlloc = sequence::plusScan(charsUsedArr,charsUsedArr,n);
   uintE* iEdges = newA(uintE,toAlloc);
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
     edgePts[i] = iEdges+charsUsedArr[i];
     long charsUsed = 
       sequentialCompressWeightedEdgeSet((uchar *)(iEdges+charsUsedArr[i]), 
@@ -376,7 +377,7 @@ uchar *parallelCompressWeightedEdges(intEPair *edges, uintT *offsets, long n, lo
                 i, edges + offsets[i]);
     charsUsed = (charsUsed+1) / 2;
     charsUsedArr[i] = charsUsed;
-  }}
+  });
 
   // produce the total space needed for all compressed lists in # of 1/2 bytes
   long totalSpace = sequence::plusScan(charsUsedArr, compressionStarts, n);
@@ -389,11 +390,11 @@ uchar *parallelCompressWeightedEdges(intEPair *edges, uintT *offsets, long n, lo
   float avgBitsPerEdge = (float)totalSpace*8 / (float)m; 
   cout << "Average bits per edge: " << avgBitsPerEdge << endl;
 
-  {parallel_for(long i=0; i<n; i++) {
+  parallel_for(0, n, [&] (long i) {
       long o = compressionStarts[i];
     memcpy(finalArr + o, (uchar *)(edgePts[i]), compressionStarts[i+1]-o);
     offsets[i] = o;
-  }}
+  });
   offsets[n] = totalSpace;
   free(iEdges);
   free(edgePts);
@@ -0,0 +1,90 @@
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+// Placement of the graph, frontiers and vertex property arrays on NUMA
+// machines. The vertices are split into one contiguous range per node, and
+// a vertex-indexed array, or the edges of a range of vertices, is placed on
+// the node of its range.
+//
+// Without libnuma, placement is by first touch. The pages are touched by a
+// parallel_for_static loop over the vertices, which gives the workers of
+// a node the same range as the dense traversals do (their chunks of about
+// equal degree are made per node, see grainProfile.h). With workers bound
+// to cores (OMP_PROC_BIND=close), a worker's range then lives on its own
+// node.
+// Compiling with NUMA defined (-lnuma) binds the ranges to the nodes
+// explicitly, which also holds for Cilk and WORKSTEAL, whose loops are
+// not affine.
+//
+// The arrays are page aligned and released with free().
+#include <stdlib.h>
+#include <iostream>
+#include "parallel.h"
+#ifdef LIGRA_NUMA
+#include <numa.h>
+#endif
+
+static const size_t numaPage = 4096;
+
+inline int numaNodes() {
+#ifdef LIGRA_NUMA
+  static int nodes = (numa_available() < 0) ? 1 : numa_num_configured_nodes();
+  return nodes;
+#else
+  return 1;
+#endif
+}
+
+inline char* pageAlignedAlloc(size_t bytes) {
+  void* A;
+  if (posix_memalign(&A, numaPage, bytes > 0 ? bytes : 1) != 0) {
+    std::cout << "pageAlignedAlloc: out of memory" << std::endl;
+    abort();
+  }
+  return (char*) A;
+}
+
+// binds the pages of A whose first byte is in [lo, hi) to node
+inline void numaBind(char* A, size_t lo, size_t hi, int node) {
+#ifdef LIGRA_NUMA
+  lo = (lo + numaPage - 1) & ~(numaPage - 1);
+  hi = (hi + numaPage - 1) & ~(numaPage - 1);
+  if (hi > lo) numa_tonode_memory(A + lo, hi - lo, node);
+#endif
+}
+
+// touches the pages of A whose first byte is in [lo, hi)
+inline void numaTouch(char* A, size_t lo, size_t hi) {
+  for (size_t p = (lo + numaPage - 1) & ~(numaPage - 1); p < hi; p += numaPage) A[p] = 0;
+}
+
+// array split into equal ranges, one per node
+inline void* numaAlloc(size_t bytes) {
+  char* A = pageAlignedAlloc(bytes);
+  const int nodes = numaNodes();
+  for (int k = 0; k < nodes; k++) numaBind(A, k*bytes/nodes, (k+1)*bytes/nodes, k);
+  long pages = (bytes + numaPage - 1) / numaPage;
+  parallel_for_static(0, pages, [&] (long p) { A[p*numaPage] = 0; });
+  return A;
+}
+
+// array of m elements of elemBytes each, where vertex i of n owns elements
+// offsets[i] to offsets[i+1]-1 (to m-1 for the last vertex), split as the
+// vertices are
+template <class O>
+void* numaAllocByOffsets(size_t elemBytes, O* offsets, long n, long m) {
+  char* A = pageAlignedAlloc(m*elemBytes);
+  const int nodes = numaNodes();
+  for (int k = 0; k < nodes; k++) {
+    long lo = k*n/nodes, hi = (k+1)*n/nodes;
+    numaBind(A, (lo < n ? offsets[lo] : m)*elemBytes, (hi < n ? offsets[hi] : m)*elemBytes, k);
+  }
+  parallel_for_static(0, n, [&] (long i) {
+      numaTouch(A, offsets[i]*elemBytes, (i+1 < n ? offsets[i+1] : m)*elemBytes);
+  });
+  return A;
+}
+
+#define newNumaA(__E,__n) (__E*) numaAlloc((__n)*sizeof(__E))
+
+#endif
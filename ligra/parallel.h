@@ -24,43 +24,56 @@
 #ifndef _PARALLEL_H
 #define _PARALLEL_H
 
-#if defined(CILK)
+// Parallel loops and fork-join, in one of the backends below. Loop bodies
+// are closures of the index:
+//
+//   parallel_for(0, n, [&] (long i) { A[i] = 0; });
+//
+// parallel_for(start, end, f, granularity) calls f(i) for i in [start,
+// end). granularity is the number of consecutive iterations a worker takes
+// at a time, 0 for the backend's default. parallel_for_static(start, end,
+// f) gives each worker one of equal contiguous ranges, the same for every
+// loop of the same length. par_do(left, right) calls left() and right() in
+// parallel and returns when both are done.
+
+#if defined(CILK) || defined(CILKP)
 #include <cilk/cilk.h>
 #define parallel_main main
-#define parallel_for cilk_for
-#define parallel_for_1 _Pragma("cilk_grainsize = 1") cilk_for
-#define parallel_for_256 _Pragma("cilk_grainsize = 256") cilk_for
 #include <cilk/cilk_api.h>
 #include <sstream>
 #include <iostream>
 #include <cstdlib>
-static int getWorkers() {
-  return __cilkrts_get_nworkers();
-}
-static void setWorkers(int n) {
-  __cilkrts_end_cilk();
-  //__cilkrts_init();
-  std::stringstream ss; ss << n;
-  if (0 != __cilkrts_set_param("nworkers", ss.str().c_str())) {
-    std::cerr << "failed to set worker count!" << std::endl;
-    std::abort();
+#include <algorithm>
+//cilk_for over blocks of granularity iterations, rather than a grainsize
+//pragma, whose argument compilers differ on
+template <class F>
+inline void parallel_for(long start, long end, F f, long granularity = 0) {
+  if (granularity == 0) {
+    cilk_for (long i=start; i<end; i++) f(i);
+  } else {
+    long blocks = (end - start + granularity - 1) / granularity;
+    cilk_for (long b=0; b<blocks; b++) {
+      long e = std::min(end, start + (b+1)*granularity);
+      for (long i=start + b*granularity; i<e; i++) f(i);
+    }
   }
 }
-
-// intel cilk+
-#elif defined(CILKP)
-#include <cilk/cilk.h>
-#define parallel_for cilk_for
-#define parallel_main main
-#define parallel_for_1 _Pragma("cilk grainsize = 1") cilk_for
-#define parallel_for_256 _Pragma("cilk grainsize = 256") cilk_for
-#include <cilk/cilk_api.h>
-#include <sstream>
-#include <iostream>
-#include <cstdlib>
+template <class F>
+inline void parallel_for_static(long start, long end, F f) {
+  cilk_for (long i=start; i<end; i++) f(i);
+}
+template <class L, class R>
+inline void par_do(L left, R right) {
+  cilk_spawn left();
+  right();
+  cilk_sync;
+}
 static int getWorkers() {
   return __cilkrts_get_nworkers();
 }
+static int getWorkerNum() {
+  return __cilkrts_get_worker_number();
+}
 static void setWorkers(int n) {
   __cilkrts_end_cilk();
   //__cilkrts_init();
@@ -74,29 +87,73 @@ static void setWorkers(int n) {
 // openmp
 #elif defined(OPENMP)
 #include <omp.h>
-#define cilk_spawn
-#define cilk_sync
 #define parallel_main main
-#define parallel_for _Pragma("omp parallel for") for
-#define parallel_for_1 _Pragma("omp parallel for schedule (static,1)") for
-#define parallel_for_256 _Pragma("omp parallel for schedule (static,256)") for
+template <class F>
+inline void parallel_for(long start, long end, F f, long granularity = 0) {
+  if (granularity == 0) {
+    _Pragma("omp parallel for") for (long i=start; i<end; i++) f(i);
+  } else {
+    _Pragma("omp parallel for schedule (static, granularity)") for (long i=start; i<end; i++) f(i);
+  }
+}
+//equal contiguous ranges, the same for every loop of the same length
+template <class F>
+inline void parallel_for_static(long start, long end, F f) {
+  _Pragma("omp parallel for schedule (static)") for (long i=start; i<end; i++) f(i);
+}
+//not nested, as nested regions run sequentially anyway
+template <class L, class R>
+inline void par_do(L left, R right) { left(); right(); }
 static int getWorkers() { return omp_get_max_threads(); }
+// id of the outermost team member, so nested (inactive) regions report
+// the worker that spawned them
+static int getWorkerNum() {
+  return omp_get_level() == 0 ? 0 : omp_get_ancestor_thread_num(1); }
 static void setWorkers(int n) { omp_set_num_threads(n); }
 
+// work stealing in plain c++11 (see scheduler.h)
+#elif defined(WORKSTEAL)
+#include "scheduler.h"
+#define parallel_main main
+using scheduler::parallel_for;
+using scheduler::parallel_for_static;
+using scheduler::par_do;
+static int getWorkers() { return scheduler::numWorkers(); }
+static int getWorkerNum() { return scheduler::workerId(); }
+static void setWorkers(int n) { scheduler::setNumWorkers(n); }
+
 // c++
 #else
-#define cilk_spawn
-#define cilk_sync
 #define parallel_main main
-#define parallel_for for
-#define parallel_for_1 for
-#define parallel_for_256 for
-#define cilk_for for
+template <class F>
+inline void parallel_for(long start, long end, F f, long granularity = 0) {
+  for (long i=start; i<end; i++) f(i);
+}
+template <class F>
+inline void parallel_for_static(long start, long end, F f) {
+  for (long i=start; i<end; i++) f(i);
+}
+template <class L, class R>
+inline void par_do(L left, R right) { left(); right(); }
 static int getWorkers() { return 1; }
+static int getWorkerNum() { return 0; }
 static void setWorkers(int n) { }
 
 #endif
 
+// The loop forms of older releases, over the closures above:
+// parallel_for_1 and parallel_for_256 are parallel_for with a granularity
+// of 1 and 256. Outside of Cilk, cilk_spawn and cilk_sync expand to
+// nothing as before, so a spawned call runs before its continuation;
+// par_do runs both in parallel. The prefix form "parallel_for (long i=0;
+// i<n; i++)" cannot be kept, since parallel_for is now a function.
+#define parallel_for_1(start, end, ...) parallel_for((start), (end), __VA_ARGS__, 1)
+#define parallel_for_256(start, end, ...) parallel_for((start), (end), __VA_ARGS__, 256)
+#if !defined(CILK) && !defined(CILKP)
+#define cilk_spawn
+#define cilk_sync
+#endif
+
 #include <limits.h>
 
 #if defined(LONG)
@@ -0,0 +1,251 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Hardware performance counters around every edgeMap, vertexMap and
+// vertexFilter call (Linux perf_event_open). Compiled in only with
+// PERF_COUNTERS defined ("PERF=1 make" or "make PERF=1"); otherwise the
+// hooks below expand to nothing.
+//
+// The counters follow the whole process: they are opened in parallel_main
+// before the first parallel loop and inherited by all worker threads, and
+// read before and after every call. Memory bandwidth is taken from the
+// uncore memory controller (uncore_imc) counters when the kernel allows
+// system-wide counting, and estimated from LLC misses otherwise.
+//
+// options:
+//   -perf-rounds   print the counters of every call, not only the totals
+//                  per traversal mode printed by PERF_FINISH
+#if defined(PERF_COUNTERS)
+
+#define PERF_OPEN(P) perf_open(P)
+#define PERF_FINISH() perf_finish()
+#define PERF_CALL_START(s) const perfSnapshot s = perf_read()
+#define PERF_EDGEMAP(mode, m, outDegrees, s) \
+  perf_call(MetaKind::EdgeMap, (mode), (m), (outDegrees), (s))
+#define PERF_VERTEXMAP(dense, m, s) \
+  perf_call(MetaKind::VertexMap, (dense) ? TraversalMode::Dense : TraversalMode::Sparse, (m), 0, (s))
+#define PERF_VERTEXFILTER(m, s) \
+  perf_call(MetaKind::VertexFilter, TraversalMode::Dense, (m), 0, (s))
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <linux/perf_event.h>
+#include "parseCommandLine.h"
+#include "traceFormat.h"
+
+enum { PerfCycles, PerfInstructions, PerfLLCMisses, PerfDTLBMisses, PerfMemBytes, NumPerfCounters };
+static const char* perfNames[NumPerfCounters] =
+  {"cycles", "instr", "LLC miss", "dTLB miss", "mem bytes"};
+
+struct perfSnapshot {
+  uint64_t v[NumPerfCounters];
+  double time;
+};
+
+struct perfCall {
+  MetaKind kind;
+  TraversalMode mode;
+  long frontier, outDegrees;
+  perfSnapshot delta;
+};
+
+struct perfCounters {
+  int fd[NumPerfCounters];
+  std::vector<int> imc;       // uncore counters, read and write CAS per controller and socket
+  std::vector<perfCall> calls;
+  bool rounds;
+  bool open;
+};
+
+static perfCounters perf_state = { {-1, -1, -1, -1, -1}, {}, {}, false, false };
+
+static inline int perf_event(uint32_t type, uint64_t config, pid_t pid, int cpu) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.inherit = pid == 0;
+  attr.exclude_kernel = pid == 0;
+  attr.exclude_hv = 1;
+  return syscall(__NR_perf_event_open, &attr, pid, cpu, -1, 0);
+}
+
+// counts of a counter, scaled up if it was multiplexed
+static inline uint64_t perf_value(int fd) {
+  uint64_t r[3];
+  if (fd < 0 || read(fd, r, sizeof(r)) != sizeof(r) || r[2] == 0) return 0;
+  return r[2] == r[1] ? r[0] : (uint64_t)((double)r[0] * r[1] / r[2]);
+}
+
+// cpus of a cpu list such as "0,18" or "0-3", as in the cpumask of an
+// uncore PMU; cpu 0 if the file cannot be read
+static inline std::vector<int> perf_cpus(const std::string& file) {
+  std::vector<int> cpus;
+  std::ifstream f(file.c_str());
+  std::string list, range;
+  if (f >> list) {
+    std::stringstream l(list);
+    while (std::getline(l, range, ',')) {
+      int lo, hi;
+      int n = sscanf(range.c_str(), "%d-%d", &lo, &hi);
+      if (n < 1) continue;
+      if (n == 1) hi = lo;
+      for (int c = lo; c <= hi; c++) cpus.push_back(c);
+    }
+  }
+  if (cpus.empty()) cpus.push_back(0);
+  return cpus;
+}
+
+// opens the read and write CAS counters of every memory controller, e.g.
+// events/cas_count_read = "event=0x04,umask=0x03", on each cpu of the
+// controller's cpumask (one per socket), so all sockets are counted
+static inline void perf_open_imc() {
+  const char* dir = "/sys/bus/event_source/devices";
+  DIR* d = opendir(dir);
+  if (d == NULL) return;
+  while (dirent* e = readdir(d)) {
+    if (strncmp(e->d_name, "uncore_imc", 10) != 0) continue;
+    std::string base = std::string(dir) + "/" + e->d_name;
+    uint32_t type;
+    std::ifstream typeFile((base + "/type").c_str());
+    if (!(typeFile >> type)) continue;
+    const std::vector<int> cpus = perf_cpus(base + "/cpumask");
+    const char* events[2] = {"cas_count_read", "cas_count_write"};
+    for (int i = 0; i < 2; i++) {
+      std::ifstream f((base + "/events/" + events[i]).c_str());
+      std::string s;
+      unsigned event = 0, umask = 0;
+      if (!(f >> s) || sscanf(s.c_str(), "event=%x,umask=%x", &event, &umask) < 1) continue;
+      for (int cpu : cpus) {
+	int fd = perf_event(type, event | umask << 8, -1, cpu);
+	if (fd >= 0) perf_state.imc.push_back(fd);
+      }
+    }
+  }
+  closedir(d);
+}
+
+static inline void perf_open(commandLine& P) {
+  perf_state.rounds = P.getOption("-perf-rounds");
+  const uint64_t dtlb = PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8
+    | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+  perf_state.fd[PerfCycles] = perf_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 0, -1);
+  perf_state.fd[PerfInstructions] = perf_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0, -1);
+  perf_state.fd[PerfLLCMisses] = perf_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 0, -1);
+  perf_state.fd[PerfDTLBMisses] = perf_event(PERF_TYPE_HW_CACHE, dtlb, 0, -1);
+  perf_open_imc();
+  for (int c = 0; c < PerfMemBytes; c++)
+    if (perf_state.fd[c] < 0)
+      std::cerr << "perf: " << perfNames[c] << " counter not available" << std::endl;
+  if (perf_state.imc.empty())
+    std::cerr << "perf: no uncore memory counters, estimating mem bytes from LLC misses" << std::endl;
+  perf_state.open = true;
+}
+
+static inline perfSnapshot perf_read() {
+  perfSnapshot s;
+  if (!perf_state.open) { memset(&s, 0, sizeof(s)); return s; }
+  for (int c = 0; c < PerfMemBytes; c++) s.v[c] = perf_value(perf_state.fd[c]);
+  uint64_t cas = 0;
+  for (int fd : perf_state.imc) cas += perf_value(fd);
+  // every CAS command transfers one 64 byte line
+  s.v[PerfMemBytes] = 64 * (perf_state.imc.empty() ? s.v[PerfLLCMisses] : cas);
+  timeval now;
+  gettimeofday(&now, NULL);
+  s.time = (double)now.tv_sec + (double)now.tv_usec / 1000000.;
+  return s;
+}
+
+static inline void perf_print(const perfSnapshot& d) {
+  std::cout << std::fixed << std::setprecision(4) << std::setw(10) << d.time;
+  for (int c = 0; c < NumPerfCounters; c++) std::cout << std::setw(14) << d.v[c];
+  std::cout << std::setprecision(2) << std::setw(7)
+            << (d.v[PerfCycles] ? (double)d.v[PerfInstructions] / d.v[PerfCycles] : 0.0)
+            << std::setw(9) << (d.time > 0 ? d.v[PerfMemBytes] / d.time / 1e9 : 0.0) << std::endl;
+}
+
+static inline void perf_header(const char* first) {
+  std::cout << std::setw(28) << first << std::setw(10) << "frontier" << std::setw(12) << "edges"
+            << std::setw(10) << "sec";
+  for (int c = 0; c < NumPerfCounters; c++) std::cout << std::setw(14) << perfNames[c];
+  std::cout << std::setw(7) << "IPC" << std::setw(9) << "GB/s" << std::endl;
+}
+
+// Must be called outside of parallel loops.
+static inline void perf_call(MetaKind kind, TraversalMode mode, long frontier, long outDegrees,
+                             const perfSnapshot& start) {
+  if (!perf_state.open) return;
+  perfSnapshot d = perf_read();
+  for (int c = 0; c < NumPerfCounters; c++) d.v[c] -= start.v[c];
+  d.time -= start.time;
+  perf_state.calls.push_back(perfCall{kind, mode, frontier, outDegrees, d});
+}
+
+static inline std::string perf_name(const perfCall& c) {
+  return c.kind == MetaKind::EdgeMap ? std::string("edgeMap ") + to_string(c.mode)
+    : std::string(to_string(c.kind));
+}
+
+// prints the counters per call (with -perf-rounds) and per traversal mode
+static inline void perf_finish() {
+  if (!perf_state.open) return;
+  std::vector<perfCall> totals;
+  if (perf_state.rounds) perf_header("call");
+  for (size_t i = 0; i < perf_state.calls.size(); i++) {
+    const perfCall& c = perf_state.calls[i];
+    if (perf_state.rounds) {
+      std::cout << std::setw(6) << i << std::setw(22) << perf_name(c) << std::setw(10)
+                << c.frontier << std::setw(12) << c.outDegrees;
+      perf_print(c.delta);
+    }
+    size_t t = 0;
+    while (t < totals.size() && (totals[t].kind != c.kind || totals[t].mode != c.mode)) t++;
+    if (t == totals.size()) {
+      totals.push_back(c);
+      totals[t].frontier = totals[t].outDegrees = 0;
+      memset(&totals[t].delta, 0, sizeof(perfSnapshot));
+    }
+    totals[t].frontier += c.frontier;
+    totals[t].outDegrees += c.outDegrees;
+    for (int k = 0; k < NumPerfCounters; k++) totals[t].delta.v[k] += c.delta.v[k];
+    totals[t].delta.time += c.delta.time;
+  }
+  perf_header("totals");
+  for (const perfCall& c : totals) {
+    std::cout << std::setw(28) << perf_name(c) << std::setw(10) << c.frontier
+              << std::setw(12) << c.outDegrees;
+    perf_print(c.delta);
+  }
+  for (int c = 0; c < PerfMemBytes; c++) if (perf_state.fd[c] >= 0) close(perf_state.fd[c]);
+  for (int fd : perf_state.imc) close(fd);
+  perf_state.imc.clear();
+  perf_state.calls.clear();
+  perf_state.open = false;
+}
+
+#else
+
+#define PERF_OPEN(P)
+#define PERF_FINISH()
+#define PERF_CALL_START(s)
+#define PERF_EDGEMAP(...)
+#define PERF_VERTEXMAP(...)
+#define PERF_VERTEXFILTER(...)
+
+#endif
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,181 @@
+#ifndef PROPAGATION_BLOCKING_H
+#define PROPAGATION_BLOCKING_H
+
+// Propagation blocking for the push traversal over a dense frontier
+// (edgeMapDenseForwardBlocked in ligra.h). Pushing along all out-edges of
+// the frontier updates targets all over the graph, and once the vertex
+// arrays no longer fit in the last level cache nearly every update misses.
+// The updates are instead made in two phases:
+//
+//   binning   the out-edges of the frontier are decoded in order, and each
+//             update is appended to the worker's block for the bucket of
+//             its target, a range of vertices whose values fit in the
+//             worker's share of the cache
+//   applying  each bucket is applied by one worker with update, without
+//             atomics, since no other worker writes its targets
+//
+// An update is binned as its target and source (and weight), for
+// update(s, d), or, if F declares pushValue(s) (pushValue(s, w) when
+// WEIGHTED) and updateValue(d, v), as its target and the value pushValue
+// returns, so the sources are only read while binning:
+//
+//   struct F {
+//     inline double pushValue(uintE s) { return x[s]; }
+//     inline bool updateValue(uintE d, double v) { y[d] += v; return 1; }
+//     ...
+//   };
+//
+// where updateValue(d, pushValue(s)) does what update(s, d) does. cond is
+// checked when an update is applied.
+#include <stdlib.h>
+#include <unistd.h>
+#include <utility>
+#include <type_traits>
+#include "parallel.h"
+#include "utils.h"
+#include "bufferPool.h"
+
+//bytes of a value of the vertex arrays, for sizing the buckets
+#define PB_VALUE_BYTES 8
+
+//bytes of the last level cache: LIGRA_LLC_BYTES if set, else as reported
+//by the system, else 8MB
+inline long llcBytes() {
+  static long bytes = 0;
+  if (bytes > 0) return bytes;
+  const char* s = getenv("LIGRA_LLC_BYTES");
+  long b = (s != NULL) ? atol(s) : 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  if (b <= 0) b = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+  if (b <= 0) b = 8L << 20;
+  return bytes = b;
+}
+
+//true if pushing along outDegrees edges into n vertices is to be blocked:
+//the vertex values do not fit in the cache, and there are about as many
+//updates as vertices, so most of their lines would be missed
+inline bool propagationBlockingPays(long n, long outDegrees) {
+  return n * PB_VALUE_BYTES > llcBytes() && outDegrees >= n;
+}
+
+namespace propagation_blocking {
+  template <class T> auto hasValues(int) -> decltype(&T::pushValue, &T::updateValue, std::true_type());
+  template <class T> std::false_type hasValues(long);
+}
+
+//a binned update of F and how it is applied
+template <class F, bool values = decltype(propagation_blocking::hasValues<F>(0))::value>
+struct pbUpdate {
+#ifndef WEIGHTED
+  struct entry { uintE d, s; };
+  static entry make(F& f, uintE s, uintE d) { entry e = {d, s}; return e; }
+  static bool apply(F& f, const entry& e) { return f.update(e.s, e.d); }
+#else
+  struct entry { uintE d, s; intE w; };
+  static entry make(F& f, uintE s, uintE d, intE w) { entry e = {d, s, w}; return e; }
+  static bool apply(F& f, const entry& e) { return f.update(e.s, e.d, e.w); }
+#endif
+};
+
+template <class F>
+struct pbUpdate<F, true> {
+#ifndef WEIGHTED
+  typedef decltype(std::declval<F&>().pushValue((uintE)0)) T;
+  struct entry { uintE d; T v; };
+  static entry make(F& f, uintE s, uintE d) { entry e = {d, f.pushValue(s)}; return e; }
+#else
+  typedef decltype(std::declval<F&>().pushValue((uintE)0, (intE)0)) T;
+  struct entry { uintE d; T v; };
+  static entry make(F& f, uintE s, uintE d, intE w) { entry e = {d, f.pushValue(s, w)}; return e; }
+#endif
+  static bool apply(F& f, const entry& e) { return f.updateValue(e.d, e.v); }
+};
+
+//Buckets of binned updates E, each a list of blocks. A worker fills one
+//block per bucket, and links it into the bucket's list when it is full.
+//The blocks are taken from one array, with room for every edge plus a
+//partly filled block per worker and bucket.
+template <class E>
+struct propagationBlocks {
+  static const int blockSize = 64;
+  static const long maxBuckets = 1024;
+  struct block { long next, n; E e[blockSize]; };
+  bufferPool& pool;
+  block* B;
+  long used; //blocks taken from B
+  long* head; //first block of bucket b, -1 if none
+  long* open; //block of worker w and bucket b at w*stride+b, -1 if none
+  int P, shift; //bucket of d is d >> shift
+  long buckets, stride;
+
+  propagationBlocks(bufferPool& _pool, long n, long edges) : pool(_pool), used(0), P(getWorkers()) {
+    //the largest buckets whose values fit in a worker's share of the
+    //cache, of at least 4096 vertices (so whole words of the bitmaps)
+    shift = 12;
+    while ((2L << shift) * PB_VALUE_BYTES * P <= llcBytes()) shift++;
+    while ((n >> shift) >= maxBuckets) shift++;
+    buckets = 1 + ((n - 1) >> shift);
+    stride = (buckets + 7) & ~7L;
+    B = pool.get<block>(edges/blockSize + min((long)P*buckets, edges) + 1);
+    head = pool.get<long>(buckets);
+    open = pool.get<long>((long)P*stride);
+    parallel_for(0, buckets, [&] (long b) { head[b] = -1; });
+    parallel_for(0, (long)P*stride, [&] (long i) { open[i] = -1; });
+  }
+
+  inline void add(const E& x) {
+    long b = x.d >> shift;
+    long& k = open[getWorkerNum()*stride + b];
+    if (k < 0) { k = fetchAdd(&used, 1L); B[k].n = 0; }
+    block& c = B[k];
+    c.e[c.n++] = x;
+    if (c.n == blockSize) { link(b, k); k = -1; }
+  }
+
+  inline void link(long b, long k) {
+    long h = atomicLoad(&head[b]);
+    do B[k].next = h; while (!atomics::tryCAS(&head[b], h, k, ATOMIC_RELAXED));
+  }
+
+  //links the blocks still being filled
+  void close() {
+    parallel_for(0, (long)P*stride, [&] (long i) {
+      long b = i % stride;
+      if (b < buckets && open[i] >= 0) { link(b, open[i]); open[i] = -1; }
+    });
+  }
+
+  //calls g on every update, the updates of a bucket by one task
+  template <class G>
+  void apply(G g) {
+    parallel_for(0, buckets, [&] (long b) {
+      for (long k = head[b]; k >= 0; k = B[k].next)
+	for (long j = 0; j < B[k].n; j++) g(B[k].e[j]);
+    }, 1);
+  }
+
+  void del() { pool.put(B); pool.put(head); pool.put(open); }
+};
+
+//functor of the binning phase, which decodes the out-edges with the
+//traversal of the vertex's codec and bins each update of f
+template <class F>
+struct pbBinF {
+  typedef pbUpdate<F> U;
+  F& f;
+  propagationBlocks<typename U::entry>& pb;
+  static const bool noOutput = true;
+  static const bool condTrue = true;
+  pbBinF(F& _f, propagationBlocks<typename U::entry>& _pb) : f(_f), pb(_pb) {}
+#ifndef WEIGHTED
+  inline bool update(uintE s, uintE d) { pb.add(U::make(f, s, d)); return 0; }
+  inline bool updateAtomic(uintE s, uintE d) { return update(s, d); }
+#else
+  inline bool update(uintE s, uintE d, intE w) { pb.add(U::make(f, s, d, w)); return 0; }
+  inline bool updateAtomic(uintE s, uintE d, intE w) { return update(s, d, w); }
+#endif
+  inline bool cond(uintE d) { return 1; }
+};
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Work-stealing scheduler of the WORKSTEAL backend (see parallel.h), in
+// plain C++11, for compilers without Cilk Plus.
+//
+// Each worker has a deque of jobs, pushed and popped at the bottom by the
+// worker, and stolen from the top by idle workers, which pick their
+// victims at random. par_do(left, right) pushes right and calls left; if
+// right was not stolen meanwhile, the worker pops it and calls it, and
+// otherwise steals other jobs until the thief is done with it. Nested
+// parallel constructs, such as the loops over the edges of high-degree
+// vertices inside loops over vertices, are just more par_dos.
+//
+// parallel_for uses lazy binary splitting: a worker runs its range
+// granularity iterations at a time, and splits off the upper half of what
+// is left only when its deque is empty, which is when no work of its own
+// is left for idle workers. A range is split only as far as the workers
+// need, and where they need it, so a skewed loop is balanced without a
+// fine granularity, and a balanced one hardly splits at all.
+//
+// The workers are started on first use. Their number is taken from
+// LIGRA_NUM_WORKERS, or is the number of hardware threads. The main
+// thread is worker 0; parallel constructs may be called from it and from
+// within other parallel constructs. Workers that find nothing to steal
+// for about a millisecond sleep until new jobs are pushed.
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+namespace scheduler {
+
+struct job {
+  std::atomic<bool> done;
+  job() : done(false) {}
+  virtual void run() = 0;
+  void execute() { run(); done.store(true, std::memory_order_release); }
+};
+
+template <class F>
+struct closureJob : job {
+  F& f;
+  closureJob(F& _f) : f(_f) {}
+  void run() { f(); }
+};
+
+// jobs are in [top, bottom); the deque is short, since a worker only
+// pushes when par_dos nest or when its deque is empty
+struct alignas(64) jobDeque {
+  static const int capacity = 1 << 12;
+  std::atomic<int> top, bottom;
+  std::atomic<bool> locked;
+  job* jobs[capacity];
+  jobDeque() : top(0), bottom(0), locked(false) {}
+
+  void lock() {
+    while (locked.exchange(true, std::memory_order_acquire))
+      while (locked.load(std::memory_order_relaxed)) ;
+  }
+  void unlock() { locked.store(false, std::memory_order_release); }
+  bool empty() {
+    return top.load(std::memory_order_relaxed) >= bottom.load(std::memory_order_relaxed);
+  }
+  void push(job* j) {
+    lock();
+    int b = bottom.load(std::memory_order_relaxed);
+    if (b == capacity) {
+      std::cout << "scheduler: job deque overflow" << std::endl;
+      abort();
+    }
+    jobs[b] = j;
+    bottom.store(b+1, std::memory_order_relaxed);
+    unlock();
+  }
+  //the positions are reset when the deque empties
+  job* pop() {
+    lock();
+    job* j = NULL;
+    int t = top.load(std::memory_order_relaxed), b = bottom.load(std::memory_order_relaxed);
+    if (b > t) { j = jobs[--b]; bottom.store(b, std::memory_order_relaxed); }
+    if (b == t) { top.store(0, std::memory_order_relaxed); bottom.store(0, std::memory_order_relaxed); }
+    unlock();
+    return j;
+  }
+  job* steal() {
+    if (empty()) return NULL;
+    lock();
+    job* j = NULL;
+    int t = top.load(std::memory_order_relaxed), b = bottom.load(std::memory_order_relaxed);
+    if (b > t) { j = jobs[t++]; top.store(t, std::memory_order_relaxed); }
+    if (b == t) { top.store(0, std::memory_order_relaxed); bottom.store(0, std::memory_order_relaxed); }
+    unlock();
+    return j;
+  }
+};
+
+inline int& workerId() {
+  static thread_local int id = 0;
+  return id;
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+struct pool {
+  int P;
+  jobDeque* deques;
+  std::vector<std::thread> threads;
+  std::atomic<bool> finished;
+  std::atomic<int> sleeping;
+  std::mutex m;
+  std::condition_variable wakeup;
+
+  pool(int _P) : P(_P), finished(false), sleeping(0) {
+    deques = new jobDeque[P];
+    for (int w = 1; w < P; w++) threads.push_back(std::thread([this, w] { work(w); }));
+  }
+  ~pool() {
+    finished.store(true);
+    {std::lock_guard<std::mutex> l(m); wakeup.notify_all();}
+    for (size_t k = 0; k < threads.size(); k++) threads[k].join();
+    delete [] deques;
+  }
+
+  //one attempt, from a random victim other than w
+  job* steal(int w) {
+    static thread_local unsigned long x = 88172645463325252UL + w;
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+    int v = x % (P-1);
+    return deques[v >= w ? v+1 : v].steal();
+  }
+  bool jobsLeft() {
+    for (int v = 0; v < P; v++) if (!deques[v].empty()) return true;
+    return false;
+  }
+  void sleep() {
+    std::unique_lock<std::mutex> l(m);
+    sleeping.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (!finished.load() && !jobsLeft()) wakeup.wait(l);
+    sleeping.fetch_sub(1);
+  }
+  //called after a push
+  void wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> l(m);
+      wakeup.notify_all();
+    }
+  }
+  void work(int w) {
+    workerId() = w;
+    long fails = 0;
+    while (!finished.load(std::memory_order_acquire)) {
+      job* j = steal(w);
+      if (j != NULL) { j->execute(); fails = 0; }
+      else if (++fails < (1 << 14)) {
+	cpuRelax();
+	if ((fails & 63) == 0) std::this_thread::yield();
+      } else { sleep(); fails = 0; }
+    }
+  }
+  //runs other jobs until j is done
+  void waitFor(job& j) {
+    int w = workerId();
+    while (!j.done.load(std::memory_order_acquire)) {
+      job* k = steal(w);
+      if (k != NULL) k->execute();
+      else cpuRelax();
+    }
+  }
+};
+
+inline int defaultWorkers() {
+  const char* s = getenv("LIGRA_NUM_WORKERS");
+  int P = (s != NULL) ? atoi(s) : (int) std::thread::hardware_concurrency();
+  return P > 0 ? P : 1;
+}
+
+//the workers are stopped at exit
+inline pool*& poolPtr() {
+  static struct holder { pool* p; holder() : p(NULL) {} ~holder() { delete p; } } h;
+  return h.p;
+}
+
+inline pool& getPool() {
+  pool*& p = poolPtr();
+  if (p == NULL) p = new pool(defaultWorkers());
+  return *p;
+}
+
+inline int numWorkers() { return getPool().P; }
+
+//only outside of parallel constructs
+inline void setNumWorkers(int n) {
+  delete poolPtr();
+  poolPtr() = new pool(n > 0 ? n : 1);
+}
+
+template <class L, class R>
+inline void par_do(L left, R right) {
+  pool& p = getPool();
+  if (p.P == 1) { left(); right(); return; }
+  jobDeque& q = p.deques[workerId()];
+  closureJob<R> r(right);
+  q.push(&r);
+  p.wake();
+  left();
+  if (q.pop() == &r) right();
+  else p.waitFor(r);
+}
+
+template <class F>
+void forRange(long s, long e, F& f, long granularity, jobDeque& q) {
+  while (e - s > granularity) {
+    if (q.empty()) {
+      long mid = s + (e - s)/2;
+      par_do([&] { forRange(s, mid, f, granularity, q); },
+	     [&] { forRange(mid, e, f, granularity, getPool().deques[workerId()]); });
+      return;
+    }
+    for (long k = s + granularity; s < k; s++) f(s);
+  }
+  for (; s < e; s++) f(s);
+}
+
+template <class F>
+inline void parallel_for(long start, long end, F f, long granularity = 0) {
+  if (end <= start) return;
+  pool& p = getPool();
+  if (p.P == 1) { for (long i=start; i<end; i++) f(i); return; }
+  //default: at least 8 chunks per worker, and at most 512 iterations per
+  //check of the deque
+  if (granularity == 0)
+    granularity = std::max(1L, std::min(512L, (end - start) / (8L*p.P)));
+  forRange(start, end, f, granularity, p.deques[workerId()]);
+}
+
+//one job per range; as with Cilk, a worker does not always get the same
+//range
+template <class F>
+inline void parallel_for_static(long start, long end, F f) {
+  long P = numWorkers(), n = end - start;
+  parallel_for(0, P, [&] (long k) {
+      for (long i = start + k*n/P; i < start + (k+1)*n/P; i++) f(i);
+    }, 1);
+}
+
+}
+
+#endif
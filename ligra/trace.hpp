@@ -1,55 +1,261 @@
 #ifndef TRACE_HPP
 #define TRACE_HPP
 
-#define DO_TRACE
-
+// Tracing is compiled in only when DO_TRACE is defined (see the *-trace
+// targets in apps/Makefile). Otherwise every hook below expands to nothing:
+// its arguments are not evaluated and the vertex structs carry no id field.
 #if defined(DO_TRACE)
 
 // constant settings
 static constexpr bool EmitHumanReadable = false;
 
 // essential macros
-#define TRACE_OPEN(filename) trace_open(filename)
+#define TRACE_OPEN(filename, P) trace_open((filename), (P))
 #define TRACE_FINISH() trace_finish()
 #define TRACE_PROP(name, value) trace_prop((name), (value))
+#define TRACE_SET_VERTEX_ID(v, i) ((v).id = (i))
+#define TRACE_REGION(name, ptr, count) trace_region((name), (ptr), (count) * sizeof(*(ptr)))
+#define TRACE_CALL_START(t) const auto t = std::chrono::steady_clock::now()
+#define TRACE_EDGEMAP(mode, m, outDegrees, threshold, output, t) \
+	trace_call(MetaKind::EdgeMap, (mode), (m), (outDegrees), (threshold), (output), (t))
+#define TRACE_VERTEXMAP(dense, m, t) \
+	trace_call(MetaKind::VertexMap, (dense) ? TraversalMode::Dense : TraversalMode::Sparse, (m), 0, 0, (m), (t))
+#define TRACE_VERTEXFILTER(m, output, t) \
+	trace_call(MetaKind::VertexFilter, TraversalMode::Dense, (m), 0, 0, (output), (t))
 
 #include <iostream>
-#include <fstream>
-
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <type_traits>
+#include "parallel.h"
+#include "parseCommandLine.h"
+#include "traceFormat.h"
+#include "traceWriter.h"
+#include "cacheSim.h"
+
+// Every worker appends its records to a private, cache-line aligned buffer
+// without taking a lock. A full buffer is handed to the background writer
+// (traceWriter.h) as one block and replaced by an empty one, so records from
+// different workers never interleave and no I/O runs on compute threads.
+// Buffers are not flushed at the end of a call: Meta and Marker records are
+// appended to the caller's buffer and end an epoch (see traceFormat.h), by
+// which the reader puts the records of all workers back in order.
+static constexpr size_t TraceBufferSize = 1 << 20;
+static constexpr size_t TraceMaxRecordSize = 256;
+
+// an array registered with TRACE_REGION
+struct TraceRegion {
+	uint64_t base, end;
+	uint16_t id;
+};
+
+struct alignas(64) TraceBuffer {
+	char* data;
+	size_t used;
+	int worker;
+	long sampleSkip; // accesses left until the next sampled one
+	TraceRegion region; // region of the previous access
+	long regionEpoch;   // trace_region_epoch when region was looked up
+	TraceBlockEncoder encoder;
+	uint64_t epoch; // of the last record, TraceNoEpoch at the start of a block
+};
+
+static constexpr uint64_t TraceNoEpoch = ~0ULL;
+
+// runtime filters, set up by trace_open
+struct TraceFilter {
+	unsigned mask;     // DataTypes recorded right now (0 outside the window)
+	unsigned typeMask; // DataTypes selected with -trace-types
+	long sampleRate;   // record one in sampleRate accesses
+	long windowFrom;   // marker window, -1 if there is none
+	long windowTo;
+};
+static TraceFilter trace_filter = { ~0u, ~0u, 1, -1, -1 };
+
+// binary blocks start with a TraceBlockHeader that is filled in on flush
+static constexpr size_t TraceBlockStart = EmitHumanReadable ? 0 : sizeof(TraceBlockHeader);
+
+static TraceWriter trace_writer;
+// with -trace-cache accesses are fed to trace_cache instead of the writer
+static bool trace_to_cache = false;
+static cacheSim trace_cache;
+static TraceBuffer* trace_buffers = nullptr;
+static int trace_workers = 0;
+// number of Meta and Marker records written so far
+static uint64_t trace_epoch = 0;
+
+// Region registry. Regions are named, and a region keeps its id when it is
+// registered again (e.g. an array that is reallocated in every round), so
+// the same array has the same id in every run. Registering a range drops
+// all regions it overlaps.
+static std::vector<std::string> trace_region_names; // name of region id i+1
+static std::vector<TraceRegion> trace_regions;      // sorted by base
+static long trace_region_epoch = 0;                 // bumped on every change
+
+static inline void trace_flush(TraceBuffer& buf) {
+	if(buf.used == TraceBlockStart) return;
+	if(!EmitHumanReadable) {
+		TraceBlockHeader h{ (uint32_t)(buf.used - TraceBlockStart), buf.encoder.records, (uint16_t)buf.worker, 0 };
+		memcpy(buf.data, &h, sizeof(h));
+	}
+	trace_writer.submit(buf.data, buf.used);
+	buf.data = trace_writer.acquire();
+	buf.used = TraceBlockStart;
+	buf.encoder.reset();
+	buf.epoch = TraceNoEpoch;
+}
 
-static std::ofstream trace_out;
+static inline TraceBuffer& trace_buffer(int worker) {
+	if(worker >= trace_workers) {
+		std::cerr << "trace: worker " << worker << " out of range" << std::endl;
+		std::abort();
+	}
+	return trace_buffers[worker];
+}
 
-static inline void trace_open(const char* filename) {
-	trace_out.open(filename, std::ofstream::out);
+// makes room for one record of at most TraceMaxRecordSize bytes
+static inline char* trace_reserve(TraceBuffer& buf) {
+	if(buf.used + TraceMaxRecordSize > TraceBufferSize) trace_flush(buf);
+	return buf.data + buf.used;
 }
 
-static inline void trace_finish() {
-	trace_out.close();
+// like trace_reserve for a binary record, which is preceded by an Epoch
+// record if it is the first of its block or of the current epoch
+static inline uint8_t* trace_reserve_epoch(TraceBuffer& buf) {
+	uint8_t* out = (uint8_t*)trace_reserve(buf);
+	if(buf.epoch != trace_epoch) {
+		uint8_t* end = buf.encoder.encodeEpoch(out, trace_epoch);
+		buf.used += end - out;
+		buf.epoch = trace_epoch;
+		out = end;
+	}
+	return out;
 }
 
-typedef uint32_t IdType; // goes up to about 4 billion
+static inline void trace_meta(const TraceMeta& m);
+
+static inline void trace_region_meta(const TraceRegion& r) {
+	trace_meta(TraceMeta{ MetaKind::Region, TraversalMode::Sparse, trace_region_names[r.id - 1], 0.0,
+		0, 0, 0, 0, 0, r.id, r.end - r.base });
+}
 
-enum class DataType : uint8_t { Edge, Vertex, Property, Weight, Aux, Marker };
-static inline const char* to_string(DataType tt) {
-	switch (tt) {
-	case DataType::Edge: return "E";
-	case DataType::Vertex: return "V";
-	case DataType::Property: return "P";
-	case DataType::Weight: return "W";
-	case DataType::Aux: return "A";
-	case DataType::Marker: return "M";
-	default: return "?";
+// Names the `bytes` bytes at ptr. Accesses to them are recorded as offsets
+// into the region. Must be called outside of parallel loops.
+static inline void trace_region(const char* name, const void* ptr, size_t bytes) {
+	if(ptr == nullptr || bytes == 0) return;
+	size_t i = 0;
+	while(i < trace_region_names.size() && trace_region_names[i] != name) i++;
+	if(i == trace_region_names.size()) {
+		if(i == TraceMaxRegions) return;
+		trace_region_names.push_back(name);
 	}
+	const TraceRegion r{ (uint64_t)(uintptr_t)ptr, (uint64_t)(uintptr_t)ptr + bytes, (uint16_t)(i + 1) };
+	trace_regions.erase(std::remove_if(trace_regions.begin(), trace_regions.end(),
+		[&](const TraceRegion& o) { return o.id == r.id || (o.base < r.end && r.base < o.end); }),
+		trace_regions.end());
+	trace_regions.insert(std::upper_bound(trace_regions.begin(), trace_regions.end(), r,
+		[](const TraceRegion& a, const TraceRegion& b) { return a.base < b.base; }), r);
+	trace_region_epoch++;
+	trace_region_meta(r);
+}
+
+// Returns the region of addr and makes addr relative to it, or returns 0
+// and leaves addr alone if it lies in no region. Looks at the region of
+// the worker's previous access first.
+static inline uint16_t trace_locate(TraceBuffer& buf, uint64_t& addr) {
+	if(buf.regionEpoch != trace_region_epoch) {
+		buf.region = TraceRegion{ 0, 0, 0 };
+		buf.regionEpoch = trace_region_epoch;
+	}
+	if(addr - buf.region.base >= buf.region.end - buf.region.base) {
+		auto it = std::upper_bound(trace_regions.begin(), trace_regions.end(), addr,
+			[](uint64_t a, const TraceRegion& r) { return a < r.base; });
+		if(it == trace_regions.begin() || addr >= (it - 1)->end) return 0;
+		buf.region = *(it - 1);
+	}
+	addr -= buf.region.base;
+	return buf.region.id;
+}
+
+// options:
+//   -trace-inflight <n>  full buffers that may wait for the writer before
+//                        workers block (default: one per worker)
+//   -trace-direct        write the trace with O_DIRECT
+//   -trace-sample <n>    record only every n-th access of each worker
+//   -trace-types <list>  record only these DataTypes, e.g. "EV" for edges
+//                        and vertices (see to_string(DataType))
+//   -trace-window <a:b>  record only after a TRACE_MARKER with an id in
+//                        [a,b] and before the next one outside of it
+//   -trace-cache <levels>        simulate a cache hierarchy instead of
+//                                writing a trace, e.g. "32K:8,1M:16,32M:16"
+//                                (see cacheSim.h); results are printed by
+//                                TRACE_FINISH
+//   -trace-cache-line <bytes>    line size (default 64)
+//   -trace-cache-policy lru|rrip replacement policy (default lru)
+// Markers themselves are always recorded.
+static inline void trace_open(const char* filename, commandLine& P) {
+	trace_filter.sampleRate = std::max(P.getOptionLongValue("-trace-sample", 1), 1L);
+	if(char* types = P.getOptionValue("-trace-types")) {
+		trace_filter.typeMask = 0;
+		for(int t = 0; t < NumDataTypes; t++)
+			if(strchr(types, to_string((DataType)t)[0])) trace_filter.typeMask |= 1u << t;
+	}
+	trace_filter.mask = trace_filter.typeMask;
+	if(char* window = P.getOptionValue("-trace-window")) {
+		if(sscanf(window, "%ld:%ld", &trace_filter.windowFrom, &trace_filter.windowTo) != 2) P.badArgument();
+		trace_filter.mask = 0;
+	}
+	trace_workers = getWorkers();
+	if(char* levels = P.getOptionValue("-trace-cache")) {
+		const string policy = P.getOptionValue("-trace-cache-policy", "lru");
+		if(policy != "lru" && policy != "rrip") P.badArgument();
+		if(!trace_cache.init(levels, P.getOptionLongValue("-trace-cache-line", 64),
+				policy == "lru" ? CachePolicy::LRU : CachePolicy::RRIP, trace_workers)) P.badArgument();
+		trace_to_cache = true;
+	}
+	const int inflight = P.getOptionIntValue("-trace-inflight", trace_workers);
+	const bool direct = P.getOption("-trace-direct");
+	TraceFileHeader h{ TraceMagic, TraceVersion, (uint32_t)trace_workers, 0 };
+	trace_epoch = 0;
+	if(!trace_to_cache)
+		trace_writer.open(filename, &h, EmitHumanReadable ? 0 : sizeof(h),
+			TraceBufferSize, trace_workers, inflight, direct);
+	void* mem;
+	if(posix_memalign(&mem, 64, trace_workers * sizeof(TraceBuffer)) != 0) std::abort();
+	trace_buffers = static_cast<TraceBuffer*>(mem);
+	for(int w = 0; w < trace_workers; w++) {
+		trace_buffers[w].data = trace_to_cache ? nullptr : trace_writer.acquire();
+		trace_buffers[w].used = TraceBlockStart;
+		trace_buffers[w].worker = w;
+		trace_buffers[w].sampleSkip = trace_filter.sampleRate;
+		trace_buffers[w].regionEpoch = -1;
+		trace_buffers[w].encoder.reset();
+		trace_buffers[w].epoch = TraceNoEpoch;
+	}
+	for(const TraceRegion& r : trace_regions) trace_region_meta(r);
 }
 
-enum class AccessType : uint8_t { Read, ReadWrite, Write };
-static inline const char* to_string(AccessType tt) {
-	switch (tt) {
-	case AccessType::Read: return "r";
-	case AccessType::ReadWrite: return "rw";
-	case AccessType::Write: return "w";
-	default: return "?";
+static inline void trace_finish() {
+	if(trace_to_cache) {
+		trace_cache.report();
+		trace_cache.del();
+		trace_to_cache = false;
+	} else {
+		for(int w = 0; w < trace_workers; w++) {
+			TraceBuffer& buf = trace_buffers[w];
+			if(buf.used != TraceBlockStart) trace_flush(buf);
+		}
+		trace_writer.close();
 	}
+	free(trace_buffers);
+	trace_buffers = nullptr;
+	trace_workers = 0;
 }
 
 template<typename T>
@@ -246,70 +452,186 @@ static inline void TRACE_AUX_RW(IdType id, T* start_addr) {
 	trace_access(DataType::Aux, AccessType::ReadWrite, (id), start_addr);
 }
 
+static inline void trace_marker(IdType id);
 static inline void TRACE_MARKER(IdType id) {
-	trace_access(DataType::Marker, AccessType::ReadWrite, id, (void*)nullptr, 0);
+	trace_marker(id);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // trace format definition
 ////////////////////////////////////////////////////////////////////////////////
-static inline void dump_entry(DataType data, AccessType access, IdType id1, IdType id2, void* start_addr, uint16_t size);
+static inline void dump_entry(TraceBuffer& buf, DataType data, AccessType access, IdType id1, IdType id2, uint64_t addr, uint16_t region, uint16_t size);
+
+// Applies the runtime filters. Returns the calling worker's buffer if the
+// access is to be recorded and null otherwise. With the default settings
+// this costs a single, always taken branch on trace_filter.mask.
+static inline TraceBuffer* trace_sample(DataType data) {
+	if(!(trace_filter.mask & (1u << (int)data))) return nullptr;
+	TraceBuffer& buf = trace_buffer(getWorkerNum());
+	if(trace_filter.sampleRate > 1) {
+		if(--buf.sampleSkip > 0) return nullptr;
+		buf.sampleSkip = trace_filter.sampleRate;
+	}
+	return &buf;
+}
 
 template<typename T>
 static inline void trace_access(DataType data, AccessType access, IdType id, T* start_addr, long unsigned int size) {
 	static_assert(sizeof(T*) == sizeof(void*), "all pointers need to be of equal size");
+	TraceBuffer* buf = trace_sample(data);
+	if(buf == nullptr) return;
+	uint64_t addr = (uint64_t)(uintptr_t)start_addr;
+	if(trace_to_cache) {
+		trace_cache.access(buf->worker, data, addr, size);
+		return;
+	}
+	const uint16_t region = trace_locate(*buf, addr);
 	if(EmitHumanReadable) {
-		trace_out << to_string(data) << "," << id << "," << start_addr << "," << size << std::endl;
+		char* out = trace_reserve(*buf);
+		buf->used += snprintf(out, TraceMaxRecordSize, "%s,%u,%u+0x%lx,%lu,%d\n",
+			to_string(data), id, region, (unsigned long)addr, size, buf->worker);
 	} else {
-		dump_entry(data, access, id, 0, start_addr, size);
+		dump_entry(*buf, data, access, id, 0, addr, region, size);
 	}
 }
 
 template<typename T>
 static inline void trace_access(DataType data, AccessType access, IdType id1, IdType id2, T* start_addr, long unsigned int size) {
 	static_assert(sizeof(T*) == sizeof(void*), "all pointers need to be of equal size");
+	TraceBuffer* buf = trace_sample(data);
+	if(buf == nullptr) return;
+	uint64_t addr = (uint64_t)(uintptr_t)start_addr;
+	if(trace_to_cache) {
+		trace_cache.access(buf->worker, data, addr, size);
+		return;
+	}
+	const uint16_t region = trace_locate(*buf, addr);
+	if(EmitHumanReadable) {
+		char* out = trace_reserve(*buf);
+		buf->used += snprintf(out, TraceMaxRecordSize, "%s,<%u %u>,%u+0x%lx,%lu,%d\n",
+			to_string(data), id1, id2, region, (unsigned long)addr, size, buf->worker);
+	} else {
+		dump_entry(*buf, data, access, id1, id2, addr, region, size);
+	}
+}
+
+// Markers are always recorded; they open and close the marker window.
+// They must be placed outside of parallel loops: a marker ends an epoch,
+// so readers put it after all accesses made before it and before all
+// accesses made after it, whichever worker made them.
+static inline void trace_marker(IdType id) {
+	if(trace_filter.windowFrom >= 0) {
+		const bool inside = id >= trace_filter.windowFrom && id <= trace_filter.windowTo;
+		trace_filter.mask = inside ? trace_filter.typeMask : 0;
+	}
+	if(trace_to_cache) {
+		trace_cache.setPhase(id);
+		return;
+	}
+	TraceBuffer& buf = trace_buffer(getWorkerNum());
 	if(EmitHumanReadable) {
-		trace_out << to_string(data) << ",<" << id1 << " " << id2 << ">," << start_addr << "," << size << std::endl;
+		// text has no epochs, so all buffers are flushed first
+		for(int w = 0; w < trace_workers; w++) trace_flush(trace_buffers[w]);
+		char* out = trace_reserve(buf);
+		buf.used += snprintf(out, TraceMaxRecordSize, "%s,%u,%p,%d,%d\n",
+			to_string(DataType::Marker), id, nullptr, 0, buf.worker);
 	} else {
-		dump_entry(data, access, id1, id2, start_addr, size);
+		dump_entry(buf, DataType::Marker, AccessType::ReadWrite, id, 0, 0, 0, 0);
+		trace_epoch++;
 	}
 }
 
+// Metadata is written like a marker and ends an epoch, so it follows every
+// access of the call it describes.
+static inline void trace_meta(const TraceMeta& m) {
+	if(trace_buffers == nullptr || trace_to_cache) return; // before TRACE_OPEN
+	TraceBuffer& buf = trace_buffer(getWorkerNum());
+	if(EmitHumanReadable) {
+		for(int w = 0; w < trace_workers; w++) trace_flush(trace_buffers[w]);
+		char* out = trace_reserve(buf);
+		if(m.kind == MetaKind::Property && m.integer)
+			buf.used += snprintf(out, TraceMaxRecordSize, "%s,%s,%.*s,%lld\n", to_string(DataType::Meta),
+				to_string(m.kind), (int)std::min(m.name.size(), TraceMaxMetaName), m.name.c_str(),
+				(long long)m.ivalue);
+		else if(m.kind == MetaKind::Property)
+			buf.used += snprintf(out, TraceMaxRecordSize, "%s,%s,%.*s,%.17g\n", to_string(DataType::Meta),
+				to_string(m.kind), (int)std::min(m.name.size(), TraceMaxMetaName), m.name.c_str(), m.value);
+		else if(m.kind == MetaKind::Region)
+			buf.used += snprintf(out, TraceMaxRecordSize, "%s,%s,%.*s,%lu,%lu\n", to_string(DataType::Meta),
+				to_string(m.kind), (int)std::min(m.name.size(), TraceMaxMetaName), m.name.c_str(),
+				(unsigned long)m.region, (unsigned long)m.bytes);
+		else
+			buf.used += snprintf(out, TraceMaxRecordSize, "%s,%s,%s,%lu,%lu,%lu,%lu,%lu\n",
+				to_string(DataType::Meta), to_string(m.kind), to_string(m.mode),
+				(unsigned long)m.frontier, (unsigned long)m.outDegrees, (unsigned long)m.threshold,
+				(unsigned long)m.output, (unsigned long)m.nanos);
+	} else {
+		uint8_t* out = trace_reserve_epoch(buf);
+		buf.used += buf.encoder.encodeMeta(out, m) - out;
+		trace_epoch++;
+	}
+}
+
+// Describes an edgeMap, vertexMap or vertexFilter call that started at t0.
+// Must be called outside of parallel loops; nothing is recorded outside of
+// the marker window or when simulating a cache.
+static inline void trace_call(MetaKind kind, TraversalMode mode, long frontier, long outDegrees,
+			      long threshold, long output, std::chrono::steady_clock::time_point t0) {
+	const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - t0).count();
+	if(trace_to_cache || trace_filter.mask == 0) return;
+	trace_meta(TraceMeta{ kind, mode, std::string(), 0.0, (uint64_t)frontier, (uint64_t)outDegrees,
+		(uint64_t)threshold, (uint64_t)output, (uint64_t)nanos });
+}
+
 template<typename T>
 static inline void trace_prop(const char* name, const T& value) {
-	if(EmitHumanReadable) {
-		trace_out << name << "=" << value << std::endl;
+	if(trace_to_cache) {
+		std::cout << name << " = " << value << std::endl;
 	} else {
-		// TODO: currently ignored for binary, do we need this info?
+		// integers are kept exact rather than converted to double
+		const bool integer = std::is_integral<T>::value;
+		trace_meta(TraceMeta{ MetaKind::Property, TraversalMode::Sparse, std::string(name), (double)value,
+			0, 0, 0, 0, 0, 0, 0, integer, integer ? (int64_t)value : 0 });
 	}
 }
 
 
 // binary
-struct Entry {
-	void*  start_addr;
-	IdType id1;
-	IdType id2;
-	uint16_t size;
-	DataType data;
-	AccessType access;
-} __attribute__((packed));
-
-static inline void dump_entry(DataType data, AccessType access, IdType id1, IdType id2, void* start_addr, uint16_t size) {
-	Entry e{ start_addr, id1, id2, size, data, access };
-	trace_out.write(reinterpret_cast<char*>(&e), sizeof(Entry));
+static inline void dump_entry(TraceBuffer& buf, DataType data, AccessType access, IdType id1, IdType id2, uint64_t addr, uint16_t region, uint16_t size) {
+	TraceRecord r{ addr, id1, id2, size, (uint16_t)buf.worker, data, access, region };
+	uint8_t* out = trace_reserve_epoch(buf);
+	buf.used += buf.encoder.encode(out, r) - out;
 }
 
 
 #else
 
-#define TRACE_OPEN(filename)
+#define TRACE_OPEN(filename, P)
 #define TRACE_FINISH()
 #define TRACE_PROP(name, value)
-#define TRACE_VERTEX_READ(id)
-#define TRACE_VERTEX_WRITE(id)
-#define TRACE_EDGE_READ(id)
-#define TRACE_EDGE_WRITE(id)
+#define TRACE_SET_VERTEX_ID(v, i)
+#define TRACE_REGION(name, ptr, count)
+#define TRACE_CALL_START(t)
+#define TRACE_EDGEMAP(...)
+#define TRACE_VERTEXMAP(...)
+#define TRACE_VERTEXFILTER(...)
+#define TRACE_VERTEX_READ(...)
+#define TRACE_VERTEX_WRITE(...)
+#define TRACE_VERTEX_RW(...)
+#define TRACE_PROP_READ(...)
+#define TRACE_PROP_WRITE(...)
+#define TRACE_PROP_RW(...)
+#define TRACE_EDGE_READ(...)
+#define TRACE_EDGE_WRITE(...)
+#define TRACE_EDGE_RW(...)
+#define TRACE_WEIGHT_READ(...)
+#define TRACE_WEIGHT_WRITE(...)
+#define TRACE_WEIGHT_RW(...)
+#define TRACE_AUX_READ(...)
+#define TRACE_AUX_WRITE(...)
+#define TRACE_AUX_RW(...)
+#define TRACE_MARKER(id)
 
 #endif
 
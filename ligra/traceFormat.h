@@ -0,0 +1,358 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+// Compact binary trace format, shared by the tracer (trace.hpp) and the
+// trace tools (traceReader.h, utils/traceDump.C).
+//
+//   File  := FileHeader Block*
+//   Block := BlockHeader Epoch (Run | Meta | Epoch)*
+//   Run   := tag:u8 size:varint region:varint count:u8 Body{count}
+//   Body  := zigzag(addr - previous addr) : varint
+//            zigzag(id1 - previous id1)   : varint
+//            id2 : varint                   (Edge and Weight records only)
+//   Meta  := (Meta << 4):u8 kind:u8 payload  (see TraceBlockEncoder::encodeMeta)
+//   Epoch := (Meta << 4):u8 Epoch:u8 epoch:varint
+//
+// tag is (DataType << 4 | AccessType << 2); all records of a run share the
+// tag, the access size and the region. Region 0 holds raw virtual
+// addresses; any other region is an array registered with TRACE_REGION,
+// its records hold the offset into the array and its name is given by a
+// Region meta record, so traces of different runs can be compared.
+// Addresses are delta-encoded against the previous record of the same
+// region (of the same DataType in region 0), id1 against the previous
+// record of the same DataType. Every block is written by a single worker
+// and the deltas restart at zero at the beginning of each block, so blocks
+// can be decoded independently of each other.
+//
+// Meta records carry graph properties, and describe the edgeMap, vertexMap
+// or vertexFilter call that performed all accesses since the previous Meta
+// or Marker record (how it traversed the graph and how long it took).
+//
+// Workers do not flush their buffers when a call ends, so a block can hold
+// the accesses of many calls, and the accesses of one call are spread over
+// the blocks of all workers. Every Meta and Marker record ends an epoch,
+// numbered in order from 0, and Epoch records give the epoch of the
+// records that follow them in the worker's stream. traceReader.h merges
+// the workers' streams by epoch, so that each Meta or Marker record comes
+// after the accesses of its epoch, as if all buffers had been flushed.
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+typedef uint32_t IdType; // goes up to about 4 billion
+
+enum class DataType : uint8_t { Edge, Vertex, Property, Weight, Aux, Marker, Meta };
+static constexpr int NumDataTypes = 7;
+static inline const char* to_string(DataType tt) {
+	switch (tt) {
+	case DataType::Edge: return "E";
+	case DataType::Vertex: return "V";
+	case DataType::Property: return "P";
+	case DataType::Weight: return "W";
+	case DataType::Aux: return "A";
+	case DataType::Marker: return "M";
+	case DataType::Meta: return "X";
+	default: return "?";
+	}
+}
+
+enum class AccessType : uint8_t { Read, ReadWrite, Write };
+static inline const char* to_string(AccessType tt) {
+	switch (tt) {
+	case AccessType::Read: return "r";
+	case AccessType::ReadWrite: return "rw";
+	case AccessType::Write: return "w";
+	default: return "?";
+	}
+}
+
+static inline bool hasSecondId(DataType data) {
+	return data == DataType::Edge || data == DataType::Weight;
+}
+
+enum class MetaKind : uint8_t { Property, EdgeMap, VertexMap, VertexFilter, Region, Epoch };
+static inline const char* to_string(MetaKind k) {
+	switch (k) {
+	case MetaKind::Property: return "property";
+	case MetaKind::Region: return "region";
+	case MetaKind::EdgeMap: return "edgeMap";
+	case MetaKind::VertexMap: return "vertexMap";
+	case MetaKind::VertexFilter: return "vertexFilter";
+	case MetaKind::Epoch: return "epoch";
+	default: return "?";
+	}
+}
+
+enum class TraversalMode : uint8_t { Sparse, Dense, DenseForward };
+static constexpr int NumTraversalModes = 3;
+static inline const char* to_string(TraversalMode m) {
+	switch (m) {
+	case TraversalMode::Sparse: return "sparse";
+	case TraversalMode::Dense: return "dense";
+	case TraversalMode::DenseForward: return "dense-forward";
+	default: return "?";
+	}
+}
+
+// metadata record; which fields are meaningful depends on kind
+struct TraceMeta {
+	MetaKind kind;
+	TraversalMode mode;   // edgeMap: traversal chosen, vertexMap: Sparse or Dense input
+	std::string name;     // property or region name
+	double value;         // property value, if not integer
+	uint64_t frontier;    // size of the input vertexSubset
+	uint64_t outDegrees;  // edgeMap: sum of the frontier's out-degrees
+	uint64_t threshold;   // edgeMap: sparse/dense threshold, 0 if planned
+	uint64_t output;      // size of the output vertexSubset
+	uint64_t nanos;       // wall time of the call
+	uint64_t region;      // region id
+	uint64_t bytes;       // region size
+	bool integer;         // property: the value is ivalue
+	int64_t ivalue;       // property value, if integer
+	uint64_t epoch;       // Epoch: epoch of the records that follow
+};
+
+static constexpr uint32_t TraceMagic = 0x5452474c; // "LGRT"
+static constexpr uint32_t TraceVersion = 5;
+static constexpr size_t TraceMaxMetaName = 64;
+// region ids go from 1 to TraceMaxRegions, 0 is the raw address space
+static constexpr int TraceMaxRegions = 255;
+// delta slots: one per DataType for region 0, then one per region
+static constexpr int TraceAddrSlots = NumDataTypes + TraceMaxRegions;
+
+struct TraceFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t workers; // blocks have worker ids below this
+	uint32_t reserved;
+};
+
+struct TraceBlockHeader {
+	uint32_t bytes;   // size of the runs following this header
+	uint32_t records;
+	uint16_t worker;
+	uint16_t reserved;
+};
+
+// one decoded access
+struct TraceRecord {
+	uint64_t addr;
+	IdType id1;
+	IdType id2;
+	uint16_t size;
+	uint16_t worker;
+	DataType data;
+	AccessType access;
+	uint16_t region;
+};
+
+static inline int addrSlot(const TraceRecord& r) {
+	return r.region == 0 ? (int)r.data : NumDataTypes + r.region - 1;
+}
+
+// address that is unique across regions, for grouping records by line
+static inline uint64_t regionAddr(const TraceRecord& r) {
+	return (uint64_t)r.region << 48 | r.addr;
+}
+
+static inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+static inline int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+static inline uint8_t* putVarint(uint8_t* p, uint64_t v) {
+	while(v >= 0x80) { *p++ = (uint8_t)(v | 0x80); v >>= 7; }
+	*p++ = (uint8_t)v;
+	return p;
+}
+
+static inline const uint8_t* getVarint(const uint8_t* p, uint64_t& v) {
+	v = 0;
+	for(int shift = 0; ; shift += 7) {
+		uint8_t b = *p++;
+		v |= (uint64_t)(b & 0x7f) << shift;
+		if(b < 0x80) return p;
+	}
+}
+
+// largest encoding of a single record, including a new run header
+static constexpr size_t TraceMaxEncodedRecord = 1 + 3 + 2 + 1 + 10 + 10 + 5;
+
+// encoder state for one block
+struct TraceBlockEncoder {
+	uint64_t prevAddr[TraceAddrSlots];
+	IdType prevId[NumDataTypes];
+	uint8_t* runCount; // count byte of the open run
+	uint8_t runTag;
+	uint16_t runSize;
+	uint16_t runRegion;
+	uint32_t records;
+
+	void reset() {
+		for(int i = 0; i < TraceAddrSlots; i++) prevAddr[i] = 0;
+		for(int i = 0; i < NumDataTypes; i++) prevId[i] = 0;
+		runCount = nullptr;
+		records = 0;
+	}
+
+	// appends r at p and returns the new end of the block
+	uint8_t* encode(uint8_t* p, const TraceRecord& r) {
+		const int t = (int)r.data;
+		const int slot = addrSlot(r);
+		const uint8_t tag = (uint8_t)(t << 4 | (int)r.access << 2);
+		if(runCount != nullptr && tag == runTag && r.size == runSize && r.region == runRegion && *runCount < 255) {
+			(*runCount)++;
+		} else {
+			*p++ = tag;
+			p = putVarint(p, r.size);
+			p = putVarint(p, r.region);
+			runCount = p;
+			*p++ = 1;
+			runTag = tag;
+			runSize = r.size;
+			runRegion = r.region;
+		}
+		p = putVarint(p, zigzag((int64_t)(r.addr - prevAddr[slot])));
+		p = putVarint(p, zigzag((int64_t)r.id1 - (int64_t)prevId[t]));
+		if(hasSecondId(r.data)) p = putVarint(p, r.id2);
+		prevAddr[slot] = r.addr;
+		prevId[t] = r.id1;
+		records++;
+		return p;
+	}
+
+	// Property: name length:varint, name bytes, integer:u8, then
+	//           value:zigzag varint if integer and value:f64 if not
+	// Region:   name length:varint, name bytes, region, bytes:varint
+	// others:   mode:u8, frontier, outDegrees, threshold, output, nanos:varint
+	uint8_t* encodeMeta(uint8_t* p, const TraceMeta& m) {
+		*p++ = (uint8_t)((int)DataType::Meta << 4);
+		*p++ = (uint8_t)m.kind;
+		if(m.kind == MetaKind::Property || m.kind == MetaKind::Region) {
+			const size_t len = m.name.size() < TraceMaxMetaName ? m.name.size() : TraceMaxMetaName;
+			p = putVarint(p, len);
+			memcpy(p, m.name.data(), len);
+			p += len;
+		}
+		if(m.kind == MetaKind::Property) {
+			*p++ = m.integer;
+			if(m.integer) p = putVarint(p, zigzag(m.ivalue));
+			else {
+				memcpy(p, &m.value, sizeof(double));
+				p += sizeof(double);
+			}
+		} else if(m.kind == MetaKind::Region) {
+			p = putVarint(p, m.region);
+			p = putVarint(p, m.bytes);
+		} else {
+			*p++ = (uint8_t)m.mode;
+			p = putVarint(p, m.frontier);
+			p = putVarint(p, m.outDegrees);
+			p = putVarint(p, m.threshold);
+			p = putVarint(p, m.output);
+			p = putVarint(p, m.nanos);
+		}
+		runCount = nullptr;
+		records++;
+		return p;
+	}
+
+	uint8_t* encodeEpoch(uint8_t* p, uint64_t epoch) {
+		*p++ = (uint8_t)((int)DataType::Meta << 4);
+		*p++ = (uint8_t)MetaKind::Epoch;
+		p = putVarint(p, epoch);
+		runCount = nullptr;
+		return p;
+	}
+};
+
+// decoder state for one block
+struct TraceBlockDecoder {
+	const uint8_t* p;
+	const uint8_t* end;
+	uint64_t prevAddr[TraceAddrSlots];
+	IdType prevId[NumDataTypes];
+	unsigned runLeft;
+	uint8_t runTag;
+	uint16_t runSize;
+	uint16_t runRegion;
+	uint16_t worker;
+	TraceMeta meta; // contents of the last Meta record
+
+	void reset(const uint8_t* begin, const uint8_t* _end, uint16_t _worker) {
+		p = begin; end = _end; worker = _worker; runLeft = 0;
+		for(int i = 0; i < TraceAddrSlots; i++) prevAddr[i] = 0;
+		for(int i = 0; i < NumDataTypes; i++) prevId[i] = 0;
+	}
+
+	void decodeMeta() {
+		uint64_t v;
+		meta.kind = (MetaKind)*p++;
+		if(meta.kind == MetaKind::Property || meta.kind == MetaKind::Region) {
+			p = getVarint(p, v);
+			meta.name.assign((const char*)p, v);
+			p += v;
+		}
+		if(meta.kind == MetaKind::Property) {
+			meta.integer = *p++;
+			if(meta.integer) {
+				p = getVarint(p, v);
+				meta.ivalue = unzigzag(v);
+				meta.value = (double)meta.ivalue;
+			} else {
+				memcpy(&meta.value, p, sizeof(double));
+				p += sizeof(double);
+			}
+		} else if(meta.kind == MetaKind::Region) {
+			p = getVarint(p, meta.region);
+			p = getVarint(p, meta.bytes);
+		} else if(meta.kind == MetaKind::Epoch) {
+			p = getVarint(p, meta.epoch);
+		} else {
+			meta.mode = (TraversalMode)*p++;
+			p = getVarint(p, meta.frontier);
+			p = getVarint(p, meta.outDegrees);
+			p = getVarint(p, meta.threshold);
+			p = getVarint(p, meta.output);
+			p = getVarint(p, meta.nanos);
+		}
+	}
+
+	// returns false once the block is exhausted; for Meta records the
+	// contents are left in meta
+	bool next(TraceRecord& r) {
+		if(runLeft == 0) {
+			if(p >= end) return false;
+			if((*p >> 4) == (int)DataType::Meta) {
+				p++;
+				decodeMeta();
+				r = TraceRecord{ 0, 0, 0, 0, worker, DataType::Meta, AccessType::Read, 0 };
+				return true;
+			}
+			uint64_t size;
+			runTag = *p++;
+			p = getVarint(p, size);
+			runSize = (uint16_t)size;
+			p = getVarint(p, size);
+			runRegion = (uint16_t)size;
+			runLeft = *p++;
+		}
+		runLeft--;
+		const int t = runTag >> 4;
+		uint64_t v;
+		r.data = (DataType)t;
+		r.access = (AccessType)((runTag >> 2) & 3);
+		r.size = runSize;
+		r.worker = worker;
+		r.region = runRegion;
+		p = getVarint(p, v);
+		r.addr = prevAddr[addrSlot(r)] += (uint64_t)unzigzag(v);
+		p = getVarint(p, v);
+		r.id1 = prevId[t] = (IdType)((int64_t)prevId[t] + unzigzag(v));
+		if(hasSecondId(r.data)) { p = getVarint(p, v); r.id2 = (IdType)v; }
+		else r.id2 = 0;
+		return true;
+	}
+};
+
+#endif // TRACE_FORMAT_H
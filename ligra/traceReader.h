@@ -0,0 +1,169 @@
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+// Streaming reader for binary traces written by trace.hpp. Only one block
+// per worker is held in memory at a time, so traces of any size can be
+// processed:
+//
+//   traceReader in("BFS.trace");
+//   TraceRecord r;
+//   while(in.next(r)) { ... }
+//
+// For records of type DataType::Meta the contents are in in.meta(), and
+// regionName(r.region) names the array a record's address is relative to.
+//
+// Records are returned epoch by epoch (see traceFormat.h): the accesses of
+// worker 0 in the epoch, then those of worker 1 and so on, and then the
+// Meta or Marker record that ended the epoch. Each worker's blocks are
+// read in file order; the offsets of blocks that were skipped while
+// looking for another worker's next block are kept until they are read.
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstdlib>
+#include "traceFormat.h"
+
+struct traceReader {
+	// the blocks of one worker
+	struct stream {
+		std::vector<uint8_t> block;
+		TraceBlockDecoder decoder;
+		std::deque<std::streamoff> offsets; // blocks found but not read yet
+		TraceRecord rec; // next record, if has
+		bool has;
+		uint64_t epoch;  // of rec
+	};
+	std::ifstream in;
+	std::streamoff scanned; // end of the last block header looked at
+	std::vector<stream> streams;
+	uint64_t epoch; // being returned
+	int cur;        // worker being returned
+	TraceRecord closer; // Meta or Marker record ending the epoch, if closed
+	TraceMeta closerMeta;
+	bool closed;
+	TraceMeta current; // contents of the last Meta record returned
+	long blocks;
+	std::vector<std::string> regions; // names by region id
+
+	traceReader(const char* filename) : in(filename, std::ifstream::in | std::ifstream::binary),
+	  cur(0), closed(false), blocks(0), regions(1, "") {
+		if(!in.is_open()) {
+			std::cout << "Unable to open file: " << filename << std::endl;
+			abort();
+		}
+		TraceFileHeader h;
+		in.read(reinterpret_cast<char*>(&h), sizeof(h));
+		if(!in || h.magic != TraceMagic || h.version != TraceVersion) {
+			std::cout << "Bad trace file: " << filename << std::endl;
+			abort();
+		}
+		scanned = sizeof(h);
+		streams.resize(h.workers);
+		for(int w = 0; w < (int)streams.size(); w++) {
+			streams[w].decoder.reset(nullptr, nullptr, w);
+			fetch(w);
+		}
+		epoch = firstEpoch();
+	}
+
+	// finds the next block header in the file, returns false at the end
+	bool scan() {
+		TraceBlockHeader h;
+		in.clear();
+		in.seekg(scanned);
+		if(!in.read(reinterpret_cast<char*>(&h), sizeof(h))) return false;
+		if(h.worker >= streams.size()) {
+			std::cout << "Bad trace block worker " << h.worker << std::endl;
+			abort();
+		}
+		streams[h.worker].offsets.push_back(scanned);
+		scanned += sizeof(h) + h.bytes;
+		return true;
+	}
+
+	// loads the next block of worker w, returns false if there is none
+	bool nextBlock(int w) {
+		stream& s = streams[w];
+		while(s.offsets.empty())
+			if(!scan()) return false;
+		TraceBlockHeader h;
+		in.clear();
+		in.seekg(s.offsets.front());
+		s.offsets.pop_front();
+		in.read(reinterpret_cast<char*>(&h), sizeof(h));
+		s.block.resize(h.bytes);
+		if(!in.read(reinterpret_cast<char*>(s.block.data()), h.bytes)) {
+			std::cout << "Truncated trace block" << std::endl;
+			abort();
+		}
+		s.decoder.reset(s.block.data(), s.block.data() + h.bytes, h.worker);
+		blocks++;
+		return true;
+	}
+
+	// reads the next record of worker w other than an Epoch record
+	void fetch(int w) {
+		stream& s = streams[w];
+		for(;;) {
+			while(!s.decoder.next(s.rec))
+				if(!nextBlock(w)) { s.has = false; return; }
+			if(s.rec.data == DataType::Meta && s.decoder.meta.kind == MetaKind::Epoch) {
+				s.epoch = s.decoder.meta.epoch;
+				continue;
+			}
+			s.has = true;
+			return;
+		}
+	}
+
+	uint64_t firstEpoch() {
+		uint64_t e = ~0ULL;
+		for(stream& s : streams)
+			if(s.has && s.epoch < e) e = s.epoch;
+		return e;
+	}
+
+	const TraceMeta& meta() { return current; }
+
+	const char* regionName(uint16_t region) {
+		return region < regions.size() ? regions[region].c_str() : "";
+	}
+
+	bool next(TraceRecord& r) {
+		for(;;) {
+			for(; cur < (int)streams.size(); cur++) {
+				stream& s = streams[cur];
+				if(!s.has || s.epoch != epoch) continue;
+				r = s.rec;
+				if(r.data == DataType::Marker || r.data == DataType::Meta) {
+					// the last record of the worker in this epoch
+					closer = r;
+					closerMeta = s.decoder.meta;
+					closed = true;
+					fetch(cur);
+					continue;
+				}
+				fetch(cur);
+				return true;
+			}
+			cur = 0;
+			epoch = firstEpoch();
+			if(closed) {
+				closed = false;
+				r = closer;
+				current = closerMeta;
+				if(r.data == DataType::Meta && current.kind == MetaKind::Region) {
+					if(current.region >= regions.size()) regions.resize(current.region + 1);
+					regions[current.region] = current.name;
+				}
+				return true;
+			}
+			if(epoch == ~0ULL) return false;
+		}
+	}
+};
+
+#endif // TRACE_READER_H
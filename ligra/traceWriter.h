@@ -0,0 +1,213 @@
+#ifndef TRACE_WRITER_H
+#define TRACE_WRITER_H
+
+// Background writer for trace blocks (used by trace.hpp). Workers hand
+// full buffers to a writer thread through a lock-free queue and take an
+// empty buffer from a second queue, so no trace I/O runs on a compute
+// thread. A worker only waits when all `inflight` spare buffers are still
+// queued for writing.
+//
+// With `direct` the file is opened with O_DIRECT. Blocks have arbitrary
+// lengths, so they are then collected in an aligned staging area and
+// written in multiples of TraceDirectAlign; the unaligned tail is written
+// after O_DIRECT has been switched off again in close().
+
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+
+static constexpr size_t TraceDirectAlign = 4096;
+
+struct TraceBlock {
+	char* data;
+	size_t used;
+};
+
+// bounded lock-free multi-producer multi-consumer queue (D. Vyukov)
+struct TraceQueue {
+	struct Cell {
+		std::atomic<size_t> seq;
+		TraceBlock block;
+	};
+	Cell* cells = nullptr;
+	size_t mask = 0;
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+
+	void init(size_t capacity) {
+		size_t n = 1;
+		while(n < capacity) n <<= 1;
+		cells = new Cell[n];
+		mask = n - 1;
+		for(size_t i = 0; i < n; i++) cells[i].seq.store(i, std::memory_order_relaxed);
+		head.store(0); tail.store(0);
+	}
+
+	void del() { delete[] cells; cells = nullptr; }
+
+	bool push(const TraceBlock& b) {
+		size_t pos = tail.load(std::memory_order_relaxed);
+		for(;;) {
+			Cell& c = cells[pos & mask];
+			intptr_t diff = (intptr_t)c.seq.load(std::memory_order_acquire) - (intptr_t)pos;
+			if(diff == 0) {
+				if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					c.block = b;
+					c.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if(diff < 0) {
+				return false;
+			} else {
+				pos = tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool pop(TraceBlock& b) {
+		size_t pos = head.load(std::memory_order_relaxed);
+		for(;;) {
+			Cell& c = cells[pos & mask];
+			intptr_t diff = (intptr_t)c.seq.load(std::memory_order_acquire) - (intptr_t)(pos + 1);
+			if(diff == 0) {
+				if(head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					b = c.block;
+					c.seq.store(pos + mask + 1, std::memory_order_release);
+					return true;
+				}
+			} else if(diff < 0) {
+				return false;
+			} else {
+				pos = head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+};
+
+struct TraceWriter {
+	int fd = -1;
+	bool direct = false;
+	size_t bufferSize = 0;
+	TraceQueue full, empty;
+	std::vector<char*> buffers;
+	std::thread thread;
+	std::atomic<bool> done;
+	std::mutex idleLock;
+	std::condition_variable idle;
+	char* stage = nullptr; // O_DIRECT staging area
+	size_t staged = 0;
+	size_t stageSize = 0;
+
+	static char* alignedAlloc(size_t bytes) {
+		void* mem;
+		if(posix_memalign(&mem, TraceDirectAlign, bytes) != 0) std::abort();
+		return static_cast<char*>(mem);
+	}
+
+	void writeAll(const char* p, size_t n) {
+		while(n > 0) {
+			ssize_t w = ::write(fd, p, n);
+			if(w < 0) { std::cerr << "trace: write failed" << std::endl; std::abort(); }
+			p += w; n -= w;
+		}
+	}
+
+	void writeBlock(const char* p, size_t n) {
+		if(!direct) { writeAll(p, n); return; }
+		while(n > 0) {
+			size_t k = std::min(n, stageSize - staged);
+			memcpy(stage + staged, p, k);
+			staged += k; p += k; n -= k;
+			if(staged == stageSize) { writeAll(stage, staged); staged = 0; }
+		}
+	}
+
+	void run() {
+		TraceBlock b;
+		for(;;) {
+			bool finished = done.load();
+			if(full.pop(b)) {
+				writeBlock(b.data, b.used);
+				empty.push(TraceBlock{ b.data, 0 });
+				continue;
+			}
+			if(finished) break;
+			std::unique_lock<std::mutex> lock(idleLock);
+			idle.wait_for(lock, std::chrono::milliseconds(1));
+		}
+	}
+
+	// `header` is written before any block
+	void open(const char* filename, const void* header, size_t headerSize,
+		  size_t _bufferSize, int workers, int inflight, bool _direct) {
+		bufferSize = _bufferSize;
+		direct = _direct;
+		int flags = O_WRONLY | O_CREAT | O_TRUNC;
+		fd = direct ? ::open(filename, flags | O_DIRECT, 0644) : -1;
+		if(fd < 0) {
+			if(direct) std::cerr << "trace: O_DIRECT not supported, using buffered writes" << std::endl;
+			direct = false;
+			fd = ::open(filename, flags, 0644);
+		}
+		if(fd < 0) { std::cerr << "trace: cannot open " << filename << std::endl; std::abort(); }
+		if(direct) {
+			stageSize = 4 * bufferSize;
+			stage = alignedAlloc(stageSize);
+		}
+		writeBlock(static_cast<const char*>(header), headerSize);
+
+		const size_t count = workers + std::max(inflight, 1);
+		full.init(count);
+		empty.init(count);
+		for(size_t i = 0; i < count; i++) {
+			buffers.push_back(alignedAlloc(bufferSize));
+			empty.push(TraceBlock{ buffers.back(), 0 });
+		}
+		done.store(false);
+		thread = std::thread([this] { run(); });
+	}
+
+	// returns an empty buffer, waits while all buffers are in flight
+	char* acquire() {
+		TraceBlock b;
+		while(!empty.pop(b)) std::this_thread::yield();
+		return b.data;
+	}
+
+	void submit(char* data, size_t used) {
+		full.push(TraceBlock{ data, used });
+		idle.notify_one();
+	}
+
+	// writes all submitted buffers and closes the file
+	void close() {
+		done.store(true);
+		idle.notify_one();
+		thread.join();
+		if(direct && staged > 0) {
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+			writeAll(stage, staged);
+		}
+		::close(fd);
+		fd = -1;
+		for(char* b : buffers) free(b);
+		buffers.clear();
+		free(stage);
+		stage = nullptr;
+		staged = 0;
+		full.del();
+		empty.del();
+	}
+};
+
+#endif // TRACE_WRITER_H
@@ -26,7 +26,9 @@
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>
+#include <limits>
 #include "parallel.h"
+#include "atomics.h"
 using namespace std;
 
 // Needed to make frequent large allocations efficient with standard
@@ -60,6 +62,28 @@ struct minF { E operator() (const E& a, const E& b) const {return (a < b) ? a :
 template <class E>
 struct maxF { E operator() (const E& a, const E& b) const {return (a>b) ? a : b;}};
 
+//monoids for edgeMapReduce: an identity and an associative combine
+template <class E>
+struct addMonoid {
+  typedef E T;
+  static E identity() { return 0; }
+  static E combine(const E& a, const E& b) { return a+b; }
+};
+
+template <class E>
+struct minMonoid {
+  typedef E T;
+  static E identity() { return std::numeric_limits<E>::max(); }
+  static E combine(const E& a, const E& b) { return (a < b) ? a : b; }
+};
+
+template <class E>
+struct maxMonoid {
+  typedef E T;
+  static E identity() { return std::numeric_limits<E>::lowest(); }
+  static E combine(const E& a, const E& b) { return (a > b) ? a : b; }
+};
+
 struct nonMaxF{bool operator() (uintE &a) {return (a != UINT_E_MAX);}};
 
 #define _SCAN_LOG_BSIZE 10
@@ -104,11 +128,11 @@ namespace sequence {
     intT _ee = _e;					\
     intT _n = _ee-_ss;					\
     intT _l = nblocks(_n,_bsize);			\
-    parallel_for (intT _i = 0; _i < _l; _i++) {		\
+    parallel_for(0, _l, [&] (intT _i) {		\
       intT _s = _ss + _i * (_bsize);			\
       intT _e = min(_s + (_bsize), _ee);		\
       _body						\
-	}						\
+	});						\
   }
 
   template <class OT, class intT, class F, class G> 
@@ -153,6 +177,19 @@ namespace sequence {
     return reduce<intT>((intT) 0, n, addF<intT>(), boolGetA<intT>(In));
   }
 
+  template <class intT>
+  struct bitsGetA {
+    ulong* A;
+    bitsGetA(ulong* AA) : A(AA) {}
+    intT operator() (intT i) {return (intT) __builtin_popcountl(A[i]);}
+  };
+
+  // number of set bits in the n words of In
+  template <class intT> 
+  intT sumBits(ulong *In, intT n) {
+    return reduce<intT>((intT) 0, n, addF<intT>(), bitsGetA<intT>(In));
+  }
+
   template <class ET, class intT, class F, class G> 
   ET scanSerial(ET* Out, intT s, intT e, F f, G g, ET zero, bool inclusive, bool back) {
     ET r = zero;
@@ -275,42 +312,19 @@ namespace sequence {
   template <class ET, class intT, class PRED> 
   intT filter(ET* In, ET* Out, intT n, PRED p) {
     bool *Fl = newA(bool,n);
-    parallel_for (intT i=0; i < n; i++) Fl[i] = (bool) p(In[i]);
+    parallel_for(0, n, [&] (intT i) { Fl[i] = (bool) p(In[i]); });
     intT  m = pack(In, Out, Fl, n);
     free(Fl);
     return m;
   }
 }
 
-template <class ET>
-inline bool CAS(ET *ptr, ET oldv, ET newv) {
-  if (sizeof(ET) == 1) {
-    return __sync_bool_compare_and_swap((bool*)ptr, *((bool*)&oldv), *((bool*)&newv));
-  } else if (sizeof(ET) == 4) {
-    return __sync_bool_compare_and_swap((int*)ptr, *((int*)&oldv), *((int*)&newv));
-  } else if (sizeof(ET) == 8) {
-    return __sync_bool_compare_and_swap((long*)ptr, *((long*)&oldv), *((long*)&newv));
-  } 
-  else {
-    std::cout << "CAS bad length : " << sizeof(ET) << std::endl;
-    abort();
-  }
-}
-
-template <class ET>
-inline bool writeMin(ET *a, ET b) {
-  ET c; bool r=0;
-  do c = *a; 
-  while (c > b && !(r=CAS(a,c,b)));
-  return r;
-}
-
-template <class ET>
-inline void writeAdd(ET *a, ET b) {
-  volatile ET newV, oldV; 
-  do {oldV = *a; newV = oldV + b;}
-  while (!CAS(a, oldV, newV));
-}
+// bitmaps with 64 bits per word, e.g. dense vertexSubsets
+inline long bitWords(long n) { return (n+63)/64; }
+inline bool getBit(ulong* A, long i) { return (A[i >> 6] >> (i & 63)) & 1; }
+inline void setBit(ulong* A, long i) { A[i >> 6] |= 1UL << (i & 63); }
+// atomic version of setBit; skips the atomic if the bit is already set
+inline void setBitAtomic(ulong* A, long i) { writeOr(&A[i >> 6], 1UL << (i & 63)); }
 
 inline uint hashInt(uint a) {
    a = (a+0x7ed55d16) + (a<<12);
@@ -333,23 +347,25 @@ inline ulong hashInt(ulong a) {
 }
 
 //remove duplicate integers in [0,...,n-1]
+//flags must be all UINT_E_MAX and are left that way; if NULL, a
+//temporary array is used
 void remDuplicates(uintE* indices, uintE* flags, long m, long n) {
-  //make flags for first time
-  if(flags == NULL) {flags = newA(uintE,n); 
-    {parallel_for(long i=0;i<n;i++) flags[i]=UINT_E_MAX;}}
-  {parallel_for(uintE i=0;i<m;i++)
+  uintE* tmp = NULL;
+  if(flags == NULL) {flags = tmp = newA(uintE,n); 
+    parallel_for(0, n, [&] (long i) { flags[i]=UINT_E_MAX; });}
+  parallel_for(0, m, [&] (uintE i) {
       if(indices[i] != UINT_E_MAX && flags[indices[i]] == UINT_E_MAX) 
 	CAS(&flags[indices[i]],(uintE)UINT_E_MAX,i);
-  }
+  });
   //reset flags
-  {parallel_for(long i=0;i<m;i++){
+  parallel_for(0, m, [&] (long i) {
       if(indices[i] != UINT_E_MAX){
 	if(flags[indices[i]] == i){ //win
 	  flags[indices[i]] = UINT_E_MAX; //reset
 	}
 	else indices[i] = UINT_E_MAX; //lost
       }
-    }
-  }
+    });
+  if(tmp != NULL) free(tmp);
 }
 #endif
@@ -1,89 +1,98 @@
 #ifndef VERTEX_H
 #define VERTEX_H
 #include "vertexSubset.h"
+#include "functorTraits.h"
+#include "grainProfile.h"
 #include "trace.hpp"
 using namespace std;
 
 namespace decode_uncompressed {
+  // next is only written if F has an output (see functorTraits.h)
   template <class V, class F>
-  inline void decodeInNghBreakEarly(V* v, long i, bool* vertexSubset, F &f, bool* next, bool parallel = 0) {
+  inline void decodeInNghBreakEarly(V* v, long i, ulong* vertexSubset, F &f, ulong* next, bool parallel = 0) {
+    typedef functorTraits<F> T;
     uintE d = v->getInDegree();
-    if (!parallel || d < 1000) {
+    if (!parallel || d < grains().nestedDegree) {
       for (uintE j=0; j<d; j++) {
         uintE ngh = v->getInNeighbor(j);
 #ifndef WEIGHTED
-        if (vertexSubset[ngh] && f.update(ngh,i))
+        if (getBit(vertexSubset,ngh) && f.update(ngh,i) && !T::noOutput)
 #else
-        if (vertexSubset[ngh] && f.update(ngh,i,v->getInWeight(j)))
+        if (getBit(vertexSubset,ngh) && f.update(ngh,i,v->getInWeight(j)) && !T::noOutput)
 #endif
-          next[i] = 1;
-        if(!f.cond(i)) break;
+          setBit(next,i); //the bits of a word belong to one task of edgeMapDense
+        if(!checkCond(f,i)) break;
       }
     } else {
-      parallel_for(uintE j=0; j<d; j++) {
+      parallel_for(0, d, [&] (uintE j) {
         uintE ngh = v->getInNeighbor(j);
 #ifndef WEIGHTED
-        if (vertexSubset[ngh] && f.updateAtomic(ngh,i))
+        if (getBit(vertexSubset,ngh) && pushUpdate(f,ngh,i) && !T::noOutput)
 #else
-        if (vertexSubset[ngh] && f.updateAtomic(ngh,i,v->getInWeight(j)))
+        if (getBit(vertexSubset,ngh) && pushUpdate(f,ngh,i,v->getInWeight(j)) && !T::noOutput)
 #endif
-          next[i] = 1;
-      }
+          setBitAtomic(next,i);
+      }, grains().nestedDegree);
     }
   }
 
   template <class V, class F>
-  inline void decodeOutNgh(V* v, long i, bool* vertexSubset, F &f, bool* next) {
+  inline void decodeOutNgh(V* v, long i, ulong* vertexSubset, F &f, ulong* next) {
+    typedef functorTraits<F> T;
     uintE d = v->getOutDegree();
-    if(d < 1000) {
-      for(uintE j=0; j<d; j++) {
-        uintE ngh = v->getOutNeighbor(j);
-#ifndef WEIGHTED
-        if (f.cond(ngh) && f.updateAtomic(i,ngh))
-#else 
-        if (f.cond(ngh) && f.updateAtomic(i,ngh,v->getOutWeight(j))) 
-#endif
-          next[ngh] = 1;
-      }
-    } else {
-      parallel_for(uintE j=0; j<d; j++) {
-        uintE ngh = v->getOutNeighbor(j);
+    parallel_for_edges(d, 0, d, [&] (uintE j) {
+      uintE ngh = v->getOutNeighbor(j);
 #ifndef WEIGHTED
-        if (f.cond(ngh) && f.updateAtomic(i,ngh)) 
+      if (checkCond(f,ngh) && pushUpdate(f,i,ngh) && !T::noOutput)
 #else
-          if (f.cond(ngh) && f.updateAtomic(i,ngh,v->getOutWeight(j)))
+      if (checkCond(f,ngh) && pushUpdate(f,i,ngh,v->getOutWeight(j)) && !T::noOutput)
 #endif
-        next[ngh] = 1;
-      }
-    }
+        setBitAtomic(next,ngh);
+    });
   }
 
+  // out-edges lo..hi-1 of v; out[j-lo] is the neighbor if it was updated
+  // and UINT_E_MAX otherwise (out is not written if F has no output)
   template <class V, class F>
-  inline void decodeOutNghSparse(V* v, long i, uintT o, F &f, uintE* outEdges) {
-    uintE d = v->getOutDegree();
-    if(d < 1000) {
-      for (uintE j=0; j < d; j++) {
-        uintE ngh = v->getOutNeighbor(j);
+  inline void decodeOutNghSparse(V* v, long i, uintT lo, uintT hi, F &f, uintE* out) {
+    for (uintT j=lo; j < hi; j++) {
+      uintE ngh = v->getOutNeighbor(j);
 #ifndef WEIGHTED
-        if(f.cond(ngh) && f.updateAtomic(i,ngh)) 
+      bool updated = checkCond(f,ngh) && pushUpdate(f,i,ngh);
 #else
-        if(f.cond(ngh) && f.updateAtomic(i,ngh,v->getOutWeight(j)))
+      bool updated = checkCond(f,ngh) && pushUpdate(f,i,ngh,v->getOutWeight(j));
 #endif
-          outEdges[o+j] = ngh;
-        else outEdges[o+j] = UINT_E_MAX;
-      }
-    } else {
-      parallel_for (uintE j=0; j < d; j++) {
-        uintE ngh = v->getOutNeighbor(j);
+      if (!functorTraits<F>::noOutput) out[j-lo] = updated ? ngh : UINT_E_MAX;
+    }
+  }
+
+  template <class M, class V, class F>
+  inline typename M::T mapInEdge(V* v, long i, uintT j, F &f) {
 #ifndef WEIGHTED
-        if(f.cond(ngh) && f.updateAtomic(i,ngh)) 
+    return f.map(v->getInNeighbor(j), i);
 #else
-        if(f.cond(ngh) && f.updateAtomic(i,ngh,v->getOutWeight(j)))
+    return f.map(v->getInNeighbor(j), i, v->getInWeight(j));
 #endif
-          outEdges[o+j] = ngh;
-        else outEdges[o+j] = UINT_E_MAX;
-      }
+  }
+
+  // reduction with M of f.map over the in-edges of v from vertexSubset, or
+  // from all vertices if all is set. Without a frontier test the combines
+  // go to four accumulators in turn, so consecutive ones do not depend on
+  // each other and the loop can be vectorized.
+  template <class M, class V, class F>
+  inline typename M::T reduceInNgh(V* v, long i, ulong* vertexSubset, F &f, bool all) {
+    typedef typename M::T T;
+    uintT d = v->getInDegree();
+    T a[4] = {M::identity(), M::identity(), M::identity(), M::identity()};
+    uintT j = 0;
+    if (all) {
+      for (; j+4 <= d; j += 4)
+        for (int k = 0; k < 4; k++) a[k] = M::combine(a[k], mapInEdge<M>(v, i, j+k, f));
     }
+    for (; j < d; j++)
+      if (all || getBit(vertexSubset, v->getInNeighbor(j)))
+        a[0] = M::combine(a[0], mapInEdge<M>(v, i, j, f));
+    return M::combine(M::combine(a[0], a[1]), M::combine(a[2], a[3]));
   }
 }
 
@@ -97,6 +106,8 @@ struct symmetricVertex {
   intE* neighbors;
 #endif
   uintT degree;
+  //edgeMapSparse may decode any range of out-edges
+  static const bool edgeRanges = true;
   void del() {free(neighbors); }
 #if defined(DO_TRACE)
 #ifndef WEIGHTED
@@ -140,18 +151,23 @@ symmetricVertex(intE* n, uintT d)
   void flipEdges() {}
 
   template <class F>
-  inline void decodeInNghBreakEarly(long i, bool* vertexSubset, F &f, bool* next, bool parallel = 0) {
+  inline void decodeInNghBreakEarly(long i, ulong* vertexSubset, F &f, ulong* next, bool parallel = 0) {
     decode_uncompressed::decodeInNghBreakEarly<symmetricVertex, F>(this, i, vertexSubset, f, next, parallel);
   }
 
   template <class F>
-  inline void decodeOutNgh(long i, bool* vertexSubset, F &f, bool* next) {
+  inline void decodeOutNgh(long i, ulong* vertexSubset, F &f, ulong* next) {
      decode_uncompressed::decodeOutNgh<symmetricVertex, F>(this, i, vertexSubset, f, next);
   }
 
   template <class F>
-  inline void decodeOutNghSparse(long i, uintT o, F &f, uintE* outEdges) {
-    decode_uncompressed::decodeOutNghSparse<symmetricVertex, F>(this, i, o, f, outEdges);
+  inline void decodeOutNghSparse(long i, uintT lo, uintT hi, F &f, uintE* out) {
+    decode_uncompressed::decodeOutNghSparse<symmetricVertex, F>(this, i, lo, hi, f, out);
+  }
+
+  template <class M, class F>
+  inline typename M::T reduceInNgh(long i, ulong* vertexSubset, F &f, bool all) {
+    return decode_uncompressed::reduceInNgh<M, symmetricVertex, F>(this, i, vertexSubset, f, all);
   }
 };
 
@@ -166,6 +182,7 @@ struct asymmetricVertex {
 #endif
   uintT outDegree;
   uintT inDegree;
+  static const bool edgeRanges = true;
   void del() {free(inNeighbors); free(outNeighbors);}
 #if defined(DO_TRACE)
 #ifndef WEIGHTED
@@ -207,18 +224,23 @@ asymmetricVertex(intE* iN, intE* oN, uintT in, uintT od)
   void flipEdges() { TRACE_VERTEX_RW(id, this); swap(inNeighbors,outNeighbors); swap(inDegree,outDegree); }
 
   template <class F>
-  inline void decodeInNghBreakEarly(long i, bool* vertexSubset, F &f, bool* next, bool parallel = 0) {
+  inline void decodeInNghBreakEarly(long i, ulong* vertexSubset, F &f, ulong* next, bool parallel = 0) {
     decode_uncompressed::decodeInNghBreakEarly<asymmetricVertex, F>(this, i, vertexSubset, f, next, parallel);
   }
 
   template <class F>
-  inline void decodeOutNgh(long i, bool* vertexSubset, F &f, bool* next) {
+  inline void decodeOutNgh(long i, ulong* vertexSubset, F &f, ulong* next) {
     decode_uncompressed::decodeOutNgh<asymmetricVertex, F>(this, i, vertexSubset, f, next);
   }
 
   template <class F>
-  inline void decodeOutNghSparse(long i, uintT o, F &f, uintE* outEdges) {
-    decode_uncompressed::decodeOutNghSparse<asymmetricVertex, F>(this, i, o, f, outEdges);
+  inline void decodeOutNghSparse(long i, uintT lo, uintT hi, F &f, uintE* out) {
+    decode_uncompressed::decodeOutNghSparse<asymmetricVertex, F>(this, i, lo, hi, f, out);
+  }
+
+  template <class M, class F>
+  inline typename M::T reduceInNgh(long i, ulong* vertexSubset, F &f, bool all) {
+    return decode_uncompressed::reduceInNgh<M, asymmetricVertex, F>(this, i, vertexSubset, f, all);
   }
 };
 
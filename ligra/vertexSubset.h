@@ -1,11 +1,16 @@
 #ifndef VERTEX_SUBSET_H
 #define VERTEX_SUBSET_H
+#include "numaPlacement.h"
 
 //*****VERTEX OBJECT*****
+// The dense representation d is a bitmap with 64 vertices per word (see
+// getBit in utils.h), so scanning or counting a dense subset touches n/8
+// bytes. Bitmaps are split over the NUMA nodes as the vertices are (see
+// numaPlacement.h).
 struct vertexSubset {
   long n, m;
   uintE* s;
-  bool* d;
+  ulong* d;
   bool isDense;
 
   // make a singleton vertex in range of n
@@ -22,12 +27,38 @@ vertexSubset(long _n) : n(_n), m(0), d(NULL), s(NULL), isDense(0) {}
 vertexSubset(long _n, long _m, uintE* indices) 
 : n(_n), m(_m), s(indices), d(NULL), isDense(0) {}
   // make vertexSubset from boolean array, where n is range
+  // (bits is packed into a bitmap and freed)
 vertexSubset(long _n, bool* bits) 
-: n(_n), d(bits), s(NULL), isDense(1)  {
-  m = sequence::sum(bits,_n); }
+: n(_n), d(packBits(bits,_n)), s(NULL), isDense(1)  {
+  m = sequence::sumBits(d,bitWords(_n)); }
   // make vertexSubset from boolean array giving number of true values
 vertexSubset(long _n, long _m, bool* bits) 
-: n(_n), m(_m), s(NULL), d(bits), isDense(1)  {}
+: n(_n), m(_m), s(NULL), d(packBits(bits,_n)), isDense(1)  {}
+  // make vertexSubset from bitmap of bitWords(n) words, where n is range
+  // (a factory, since with EDGELONG ulong* is also uintE*, the type of the
+  // index arrays above)
+  static vertexSubset fromBits(long _n, ulong* bits) {
+    return fromBits(_n, sequence::sumBits(bits,bitWords(_n)), bits);
+  }
+  // make vertexSubset from bitmap giving number of set bits
+  static vertexSubset fromBits(long _n, long _m, ulong* bits) {
+    vertexSubset V(_n);
+    V.m = _m; V.d = bits; V.isDense = 1;
+    return V;
+  }
+
+  static ulong* packBits(bool* bits, long n) {
+    long words = bitWords(n);
+    ulong* A = newNumaA(ulong,words);
+    parallel_for_static(0, words, [&] (long w) {
+      long e = min(n,64*(w+1));
+      ulong x = 0;
+      for(long i=64*w;i<e;i++) if(bits[i]) x |= 1UL << (i & 63);
+      A[w] = x;
+    });
+    free(bits);
+    return A;
+  }
 
   // delete the contents
   void del(){
@@ -41,9 +72,10 @@ vertexSubset(long _n, long _m, bool* bits)
   // converts to dense but keeps sparse representation if there
   void toDense() {
     if (d == NULL) {
-      d = newA(bool,n);
-      {parallel_for(long i=0;i<n;i++) d[i] = 0;}
-      {parallel_for(long i=0;i<m;i++) d[s[i]] = 1;}
+      long words = bitWords(n);
+      d = newNumaA(ulong,words);
+      parallel_for_static(0, words, [&] (long i) { d[i] = 0; });
+      parallel_for(0, m, [&] (long i) { setBitAtomic(d,s[i]); });
     }
     isDense = true;
   }
@@ -51,12 +83,22 @@ vertexSubset(long _n, long _m, bool* bits)
   // converts to sparse but keeps dense representation if there
   void toSparse() {
     if (s == NULL) {
-      _seq<uintE> R = sequence::packIndex<uintE>(d,n);
-      if (m != R.n) {
+      // offsets of the words' first vertices in s
+      long words = bitWords(n);
+      uintE* offsets = newA(uintE,words);
+      parallel_for(0, words, [&] (long w) { offsets[w] = __builtin_popcountl(d[w]); });
+      long total = sequence::plusScan(offsets,offsets,words);
+      if (m != total) {
 	cout << "bad stored value of m" << endl; 
 	abort();
       }
-      s = R.A;
+      s = newA(uintE,m);
+      parallel_for(0, words, [&] (long w) {
+	ulong x = d[w];
+	uintE o = offsets[w];
+	while (x) { s[o++] = 64*w + __builtin_ctzl(x); x &= x-1; }
+      });
+      free(offsets);
     }
     isDense = false;
   }
@@ -64,10 +106,12 @@ vertexSubset(long _n, long _m, bool* bits)
   bool eq (vertexSubset& b) {
     toDense();
     b.toDense();
-    bool* c = newA(bool,n);
-    {parallel_for (long i=0; i<b.n; i++) 
-	c[i] = (d[i] != b.d[i]);}
-    bool equal = (sequence::sum(c,n) == 0);
+    long words = bitWords(n);
+    bool* c = newA(bool,words);
+    parallel_for(0, words, [&] (long i) {
+	c[i] = (d[i] != b.d[i]);
+    });
+    bool equal = (sequence::sum(c,words) == 0);
     free(c);
     return equal;
   }
@@ -75,7 +119,7 @@ vertexSubset(long _n, long _m, bool* bits)
   void print() {
     if (isDense) {
       cout << "D:";
-      for (long i=0;i<n;i++) if (d[i]) cout << i << " ";
+      for (long i=0;i<n;i++) if (getBit(d,i)) cout << i << " ";
       cout << endl;
     } else {
       cout << "S:";
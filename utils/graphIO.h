@@ -158,22 +158,22 @@ template <class intT>
 edgeArray<intT> remDuplicates(edgeArray<intT> A) {
   intT m = A.nonZeros;
   edge<intT> * E = newA(edge<intT>,m);
-  {parallel_for(intT i=0;i<m;i++) {E[i].u = A.E[i].u; E[i].v = A.E[i].v;}}
+  parallel_for(0, m, [&] (intT i) {E[i].u = A.E[i].u; E[i].v = A.E[i].v;});
   quickSort(E,m,edgeCmp());
 
   intT* flags = newA(intT,m);
   flags[0] = 1;
-  {parallel_for(intT i=1;i<m;i++) {
+  parallel_for(1, m, [&] (intT i) {
     if((E[i].u != E[i-1].u) || (E[i].v != E[i-1].v)) flags[i] = 1;
     else flags[i] = 0;
-    }}
+    });
 
   intT mm = sequence::plusScan(flags,flags,m);
   edge<intT>* F = newA(edge<intT>,mm);
   F[mm-1] = E[m-1];
-  {parallel_for(intT i=0;i<m-1;i++) {
+  parallel_for(0, m-1, [&] (intT i) {
     if(flags[i] != flags[i+1]) F[flags[i]] = E[i];
-    }}
+    });
   free(flags);
   return edgeArray<intT>(F,A.numRows,A.numCols,mm);
 }
@@ -189,10 +189,10 @@ edgeArray<intT> makeSymmetric(edgeArray<intT> A) {
   edge<intT> *F = newA(edge<intT>,2*m);
   intT mm = sequence::filter(E,F,m,nEQF<intT>());
 
-  parallel_for (intT i=0; i < mm; i++) {
+  parallel_for(0, mm, [&] (intT i) {
     F[i+mm].u = F[i].v;
     F[i+mm].v = F[i].u;
-  }
+  });
 
   edgeArray<intT> R = remDuplicates(edgeArray<intT>(F,A.numRows,A.numCols,2*mm));
   free(F);
@@ -209,7 +209,7 @@ graph<intT> graphFromEdges(edgeArray<intT> EA, bool makeSym) {
   if (makeSym) A = makeSymmetric<intT>(EA);
   else {  // should have copy constructor
     edge<intT> *E = newA(edge<intT>,EA.nonZeros);
-    parallel_for (intT i=0; i < EA.nonZeros; i++) E[i] = EA.E[i];
+    parallel_for(0, EA.nonZeros, [&] (intT i) { E[i] = EA.E[i]; });
     A = edgeArray<intT>(E,EA.numRows,EA.numCols,EA.nonZeros);
   }
   intT m = A.nonZeros;
@@ -218,7 +218,7 @@ graph<intT> graphFromEdges(edgeArray<intT> EA, bool makeSym) {
   intSort::iSort(A.E,offsets,m,n,getuF<intT>());
   intT *X = newA(intT,m);
   vertex<intT> *v = newA(vertex<intT>,n);
-  parallel_for (intT i=0; i < n; i++) {
+  parallel_for(0, n, [&] (intT i) {
     intT o = offsets[i];
     intT l = ((i == n-1) ? m : offsets[i+1])-offsets[i];
     v[i].degree = l;
@@ -226,7 +226,7 @@ graph<intT> graphFromEdges(edgeArray<intT> EA, bool makeSym) {
     for (intT j=0; j < l; j++) {
       v[i].Neighbors[j] = A.E[o+j].v;
     }
-  }
+  });
   A.del();
   free(offsets);
   return graph<intT>(v,n,m,X);
@@ -266,13 +266,14 @@ namespace benchIO {
 
   // parallel code for converting a string to words
   words stringToWords(char *Str, long n) {
-    parallel_for (long i=0; i < n; i++) 
-      if (isSpace(Str[i])) Str[i] = 0; 
+    parallel_for(0, n, [&] (long i) {
+      if (isSpace(Str[i])) Str[i] = 0;
+    }); 
 
     // mark start of words
     bool *FL = newA(bool,n);
     FL[0] = Str[0];
-    parallel_for (long i=1; i < n; i++) FL[i] = Str[i] && !Str[i-1];
+    parallel_for(1, n, [&] (long i) { FL[i] = Str[i] && !Str[i-1]; });
     
     // offset for each start of word
     _seq<long> Off = sequence::packIndex<long>(FL, n);
@@ -281,7 +282,7 @@ namespace benchIO {
 
     // pointer to each start of word
     char **SA = newA(char*, m);
-    parallel_for (long j=0; j < m; j++) SA[j] = Str+offsets[j];
+    parallel_for(0, m, [&] (long j) { SA[j] = Str+offsets[j]; });
 
     free(offsets); free(FL);
     return words(Str,n,SA,m);
@@ -333,15 +334,16 @@ namespace benchIO {
   template <class T>
   _seq<char> arrayToString(T* A, long n) {
     long* L = newA(long,n);
-    {parallel_for(long i=0; i < n; i++) L[i] = xToStringLen(A[i])+1;}
+    parallel_for(0, n, [&] (long i) { L[i] = xToStringLen(A[i])+1; });
     long m = sequence::scan(L,L,n,addF<long>(),(long) 0);
     char* B = newA(char,m);
-    parallel_for(long j=0; j < m; j++) 
+    parallel_for(0, m, [&] (long j) {
       B[j] = 0;
-    parallel_for(long i=0; i < n-1; i++) {
+    });
+    parallel_for(0, n-1, [&] (long i) {
       xToString(B + L[i],A[i]);
       B[L[i+1] - 1] = '\n';
-    }
+    });
     xToString(B + L[n-1],A[n-1]);
     B[m-1] = '\n';
     free(L);
@@ -428,9 +430,9 @@ namespace benchIO {
     intT *Out = newA(uintT, totalLen);
     Out[0] = n;
     Out[1] = m;
-    parallel_for (long i=0; i < n; i++) {
+    parallel_for(0, n, [&] (long i) {
       Out[i+2] = G.V[i].degree;
-    }
+    });
     long total = sequence::scan(Out+2,Out+2,n,addF<intT>(),(intT)0);
     for (long i=0; i < n; i++) {
       intT *O = Out + (2 + n + Out[i+2]);
@@ -451,9 +453,9 @@ namespace benchIO {
     intT *Out = newA(intT, totalLen);
     Out[0] = n;
     Out[1] = m;
-    parallel_for (long i=0; i < n; i++) {
+    parallel_for(0, n, [&] (long i) {
       Out[i+2] = G.V[i].degree;
-    }
+    });
     long total = sequence::scan(Out+2,Out+2,n,addF<intT>(),(intT)0);
     for (long i=0; i < n; i++) {
       intT *O = Out + (2 + n + Out[i+2]);
@@ -480,15 +482,16 @@ namespace benchIO {
       }
       if(k >= S.n || S.A[k] != '#') break; 
     }
-    parallel_for(long i=0;i<S.n-k;i++) S2[i] = S.A[k+i];
+    parallel_for(0, S.n-k, [&] (long i) { S2[i] = S.A[k+i]; });
     S.del();
 
     words W = stringToWords(S2, S.n-k);
     long n = W.m/2;
     edge<intT> *E = newA(edge<intT>,n);
-    {parallel_for(long i=0; i < n; i++)
+    parallel_for(0, n, [&] (long i) {
       E[i] = edge<intT>(atol(W.Strings[2*i]), 
-		  atol(W.Strings[2*i + 1]));}
+		  atol(W.Strings[2*i + 1]));
+    });
     W.del();
 
     long maxR = 0;
@@ -512,7 +515,7 @@ namespace benchIO {
 
     long len = W.m -1;
     uintT * In = newA(uintT, len);
-    {parallel_for(long i=0; i < len; i++) In[i] = atol(W.Strings[i + 1]);}
+    parallel_for(0, len, [&] (long i) { In[i] = atol(W.Strings[i + 1]); });
     W.del();
     
     long n = In[0];
@@ -526,12 +529,12 @@ namespace benchIO {
     uintT* offsets = In+2;
     uintT* edges = In+2+n;
 
-    parallel_for (uintT i=0; i < n; i++) {
+    parallel_for(0, n, [&] (uintT i) {
       uintT o = offsets[i];
       uintT l = ((i == n-1) ? m : offsets[i+1])-offsets[i];
       v[i].degree = l;
       v[i].Neighbors = (intT*)(edges+o);
-    }
+    });
     return graph<intT>(v,(intT)n,(uintT)m,(intT*)In);
   }
 
@@ -546,7 +549,7 @@ namespace benchIO {
     
     long len = W.m -1;
     intT * In = newA(intT, len);
-    {parallel_for(long i=0; i < len; i++) In[i] = atol(W.Strings[i + 1]);}
+    parallel_for(0, len, [&] (long i) { In[i] = atol(W.Strings[i + 1]); });
     W.del();
     
     long n = In[0];
@@ -560,13 +563,13 @@ namespace benchIO {
     uintT* offsets = (uintT*)In+2;
     uintT* edges = (uintT*)In+2+n;
     intT* weights = In+2+n+m;
-    parallel_for (uintT i=0; i < n; i++) {
+    parallel_for(0, n, [&] (uintT i) {
       uintT o = offsets[i];
       uintT l = ((i == n-1) ? m : offsets[i+1])-offsets[i];
       v[i].degree = l;
       v[i].Neighbors = (intT*)(edges+o);
       v[i].nghWeights = (weights+o);
-    }
+    });
     return wghGraph<intT>(v,(intT)n,(uintT)m,(intT*)In,weights);
   }
 };